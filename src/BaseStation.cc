@@ -4,98 +4,22 @@
 #include <ctime>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <complex>
 #include <getopt.h>
 #include <liquid/liquid.h>
 #include <sys/time.h>
 
-#include <liquid/ofdmtxrx.h>
 #include "timer.h"
-
-#define lock(s) pthread_mutex_lock(s)
-#define unlock(s) pthread_mutex_unlock(s)
-
-#define READY_TO_TX 1
-#define WAITING_FOR_ACK 2
-
-
-pthread_mutex_t transmitted_packets_mutex;
-pthread_mutex_t retransmit_packets_mutex;
+#include "evlog.h"
+#include "usrp_transceiver.h"
+#include "txpipeline.h"
+#include "bsnode.h"
+#include "linkstats.h"
+#include "aggregator.h"
+#include "erasure.h"
 
 timer program_timer = timer_create();
-std::string log_string = "";
-time_t tn;
-struct tm *now;
-struct timeval tv;
-
-void log(std::string msg)
-{
-	//float f = timer_toc(program_timer);
-	gettimeofday(&tv, NULL);
-	float s = tv.tv_sec;
-	s = s - 1e7;
-	float us = tv.tv_usec;
-	float ts = (s + us*1e-6f);
-	std::ostringstream os;
-	os.precision(20);
-	os << ts << ":" << msg << std::endl;
-	log_string += os.str();
-}	
-
-struct packet
-{
-	unsigned int id;
-	unsigned int tx_attempts;
-	unsigned char data[1024];
-	timer send_timer;
-	bool operator ==(const packet &rhs)
-	{
-		return id == rhs.id;
-	}
-};
-
-std::list<packet> transmitted_packets;
-std::list<unsigned int> retransmit_packets;
-
-unsigned int received_acks = 0;
-unsigned int received_nacks = 0;
-unsigned int timeouts  = 0;
-unsigned int state = READY_TO_TX;
-unsigned int pid = 0;
-
-int callback(unsigned char *  _header,
-		int              _header_valid,
-		unsigned char *  _payload,
-		unsigned int     _payload_len,
-		int              _payload_valid,
-		framesyncstats_s _stats,
-		void *           _userdata)
-{
-	if(_header_valid)
-	{
-		unsigned int packet_type = _header[2];
-		unsigned int rx_id = (_header[0] << 8 | _header[1]);
-		if(packet_type == 0)
-		{
-			packet pk;
-			pk.id = rx_id;
-			lock(&transmitted_packets_mutex);
-			transmitted_packets.remove(pk);
-			unlock(&transmitted_packets_mutex);
-			state = READY_TO_TX;
-			received_acks++;
-		}
-		else if(packet_type == 1)
-		{
-			lock(&retransmit_packets_mutex);
-			retransmit_packets.push_back(rx_id);
-			unlock(&retransmit_packets_mutex);
-			received_nacks++;
-			state = READY_TO_TX;
-		}
-	}
-	return 0;
-}
 
 void usage() {
 	printf("Transmission options:\n");
@@ -121,6 +45,9 @@ void usage() {
 	printf("  Available options:\n");
 	liquid_print_fec_schemes();
 	printf("\n");
+	printf("  --rate-adapt				Choose modulation and FEC per packet from the EVM the UAV\n");
+	printf("					reports, overriding the three options above\n");
+	printf("								[Default: false]\n");
 	printf("OFDM options:\n");
 	printf("  --num-subcarriers			Set the number of OFDM subcarriers\n");
 	printf("								[Default: 48]\n");
@@ -132,28 +59,78 @@ void usage() {
 	printf("  --num-packets				Set the number of packets to send to the UAV\n");
 	printf("								[Default: 1000]\n");
 	printf("  --payload-len				Set the size of each packet\n");
-	printf("								[Default: 1024 bytes]\n");
+	printf("								[Default: 4096 bytes]\n");
+	printf("  --msg-len				Send messages of this many bytes, packed into frames of up to\n");
+	printf("					payload-len bytes, instead of full frames\n");
+	printf("								[Default: 0 (off)]\n");
+	printf("  --num-messages				Set the number of messages to send to each UAV\n");
+	printf("								[Default: 10000]\n");
+	printf("  --msg-rate				Set the messages offered per second to each UAV (0: all at once)\n");
+	printf("								[Default: 0]\n");
+	printf("  --aggregate-delay			Set the longest a message waits for others to share its frame\n");
+	printf("								[Default: 0.01 seconds]\n");
+	printf("  --input				Send the bytes of this file (- for stdin) to each UAV instead of\n");
+	printf("					random data; the run ends with the input\n");
+	printf("								[Default: none]\n");
+	printf("  --seed				Set the seed of the random payload data\n");
+	printf("								[Default: 1]\n");
 	printf("  --retransmit-timeout			Set the time to wait before retransmitting packets\n");
 	printf("								[Default: 1.0 seconds]\n");
 	printf("  --response-timeout			Set the time to wait for a response\n");
 	printf("								[Default: 0.2 seconds]\n");
+	printf("  --fixed-timeouts			Keep both timeouts as given instead of starting from them and\n");
+	printf("					adapting them to the measured ack round-trip time\n");
+	printf("								[Default: false]\n");
+	printf("  --erasure				Follow every K new packets with R erasure repair frames, from\n");
+	printf("					which the UAV rebuilds up to R lost ones (K,R; 0,0: off)\n");
+	printf("								[Default: 0,0]\n");
+	printf("  --window				Set the number of unacknowledged packets allowed in flight\n");
+	printf("								[Default: 1 (stop-and-wait)]\n");
+	printf("  --num-uavs				Set the number of UAVs served (session ids 0..N-1)\n");
+	printf("								[Default: 1]\n");
+	printf("  --scheduler				Set how airtime is shared between UAVs: rr or pf\n");
+	printf("								[Default: rr (round-robin)]\n");
+	printf("  --tx-queue				Set the number of frames queued for the transmit thread\n");
+	printf("					(0: transmit from the protocol loop)\n");
+	printf("								[Default: 2]\n");
+	printf("  --stats-name				Publish live link stats in this shared-memory segment for\n");
+	printf("					uavstat (none: do not publish)\n");
+	printf("								[Default: %s]\n", LINKSTATS_NAME_BASESTATION);
+	printf("  --tsc-clock				Read timestamps from the CPU timestamp counter\n");
+	printf("								[Default: false]\n");
 	printf("  --verbose				Enable extra output\n");
 	printf("								[Default: false]\n");
 	printf("  --help				Display this help message\n");
 	exit(0);
 }
 
+// snapshot of the base station's counters for uavstat
+void fill_stats(linkstats_page_s * _page, void * _userdata)
+{
+	bsnode bs = (bsnode) _userdata;
+	bsnode_stats_s s;
+	bsnode_get_stats(bs, &s);
+	_page->frames_sent = s.num_transmissions;
+	_page->packets_delivered = s.num_delivered;
+	_page->bytes_delivered = s.num_bytes_delivered;
+	_page->acks = s.received_acks;
+	_page->nacks = s.received_nacks;
+	_page->timeouts = s.timeouts;
+	bsnode_get_rtt(bs, &_page->rtt);
+	bsnode_get_link_quality(bs, &_page->evm, &_page->rssi);
+}
+
 int main (int argc, char **argv)
 {
 	timer_tic(program_timer);
-	log("base station started");
 	// command-line options
-	bool verbose = false;
+	bsnode_props_s props;
+	bsnode_props_init_default(&props);
+	bool tsc_clock = false;
 	double frequency = 462e6;         // carrier frequency
 	double bandwidth = 500e3f;         // bandwidth
 	double tx_frequency = frequency;         // carrier frequency
 	double rx_frequency = 464e6;       // carrier frequency
-	unsigned int num_frames = 1000;     // number of frames to transmit
 	float uhd_rxgain = 20.0;
 	double txgain_dB = -12.0f;          // software tx gain [dB]
 	double uhd_txgain = 40.0;           // uhd (hardware) tx gain
@@ -163,14 +140,8 @@ int main (int argc, char **argv)
 	unsigned int cp_len = 6;            // cyclic prefix length
 	unsigned int taper_len = 4;         // taper length
 
-	modulation_scheme ms = LIQUID_MODEM_BPSK;// modulation scheme
-	unsigned int payload_len = 4096;        // original data message length
-//	fec_scheme fec0 = LIQUID_FEC_CONV_V29P23;      // fec (inner)
-	fec_scheme fec0 = LIQUID_FEC_NONE;      // fec (inner)
-	fec_scheme fec1 = LIQUID_FEC_RS_M8; // fec (outer)
-
-	float packet_timeout = 1.0;
-	float response_timeout = .2;
+	unsigned int tx_queue = 2;          // frames queued for the tx thread
+	const char * stats_name = LINKSTATS_NAME_BASESTATION;
 
 
 
@@ -194,6 +165,21 @@ int main (int argc, char **argv)
 		{"retransmit-timeout",	required_argument, 0, 'n'},
 		{"help",                no_argument,       0, 'o'},
 		{"verbose",				no_argument, 0, 'p'},
+		{"window",				required_argument, 0, 'r'},
+		{"tsc-clock",			no_argument, 0, 's'},
+		{"num-uavs",			required_argument, 0, 't'},
+		{"scheduler",			required_argument, 0, 'u'},
+		{"rate-adapt",			no_argument,       0, 'v'},
+		{"msg-len",			required_argument, 0, 'w'},
+		{"num-messages",		required_argument, 0, 'x'},
+		{"msg-rate",			required_argument, 0, 'y'},
+		{"aggregate-delay",	required_argument, 0, 'z'},
+		{"tx-queue",			required_argument, 0, 'A'},
+		{"stats-name",			required_argument, 0, 'B'},
+		{"fixed-timeouts",		no_argument,       0, 'C'},
+		{"input",				required_argument, 0, 'D'},
+		{"seed",				required_argument, 0, 'E'},
+		{"erasure",				required_argument, 0, 'F'},
 	};
 	int option_index = 0;
 
@@ -232,46 +218,95 @@ int main (int argc, char **argv)
 				taper_len = atoi(optarg);
 				break;
 			case 'i' :
-				num_frames = atoi(optarg);
+				props.num_frames = atoi(optarg);
 				break;
 			case 'j' :
-				payload_len = atoi(optarg);
+				props.payload_len = atoi(optarg);
 				break;
 			case 'k' :
-				ms = liquid_getopt_str2mod(optarg);
-				if(ms == LIQUID_MODEM_UNKNOWN)
+				props.ms = liquid_getopt_str2mod(optarg);
+				if(props.ms == LIQUID_MODEM_UNKNOWN)
 				{
-					std::cout << "Modulation scheme " << ms << " not supported. Using QPSK." << std::endl;
-					ms = LIQUID_MODEM_QPSK;
+					std::cout << "Modulation scheme " << props.ms << " not supported. Using QPSK." << std::endl;
+					props.ms = LIQUID_MODEM_QPSK;
 				}
 				break;
 			case 'l' :
-				fec0 = liquid_getopt_str2fec(optarg);
-				if(fec0 == LIQUID_FEC_UNKNOWN)
+				props.fec0 = liquid_getopt_str2fec(optarg);
+				if(props.fec0 == LIQUID_FEC_UNKNOWN)
 				{
-					std::cout << "FEC scheme " << fec0 << " not supported. Using none." << std::endl;
-					fec0 = LIQUID_FEC_NONE;
+					std::cout << "FEC scheme " << props.fec0 << " not supported. Using none." << std::endl;
+					props.fec0 = LIQUID_FEC_NONE;
 				}
 				break;
 			case 'm' :
-				fec1 = liquid_getopt_str2fec(optarg);
-				if(fec1 == LIQUID_FEC_UNKNOWN)
+				props.fec1 = liquid_getopt_str2fec(optarg);
+				if(props.fec1 == LIQUID_FEC_UNKNOWN)
 				{
-					std::cout << "FEC scheme " << fec1 << " not supported. Using none." << std::endl;
-					fec1 = LIQUID_FEC_NONE;
+					std::cout << "FEC scheme " << props.fec1 << " not supported. Using none." << std::endl;
+					props.fec1 = LIQUID_FEC_NONE;
 				}
 				break;
 			case 'n' :
-				packet_timeout = atof(optarg);
+				props.packet_timeout = atof(optarg);
 				break;
 			case 'o' :
 				usage();
 				break;
 			case 'p' :
-				verbose = true;
+				props.verbose = true;
 				break;
 			case 'q':
-				response_timeout = atof(optarg);
+				props.response_timeout = atof(optarg);
+				break;
+			case 'r':
+				props.window_size = atoi(optarg);
+				break;
+			case 's':
+				tsc_clock = true;
+				break;
+			case 't':
+				props.num_uavs = atoi(optarg);
+				break;
+			case 'u':
+				props.scheduler = scheduler_str2type(optarg);
+				break;
+			case 'v':
+				props.rate_adapt = true;
+				break;
+			case 'w' :
+				props.msg_len = atoi(optarg);
+				break;
+			case 'x' :
+				props.num_messages = atoi(optarg);
+				break;
+			case 'y' :
+				props.msg_rate = atof(optarg);
+				break;
+			case 'z' :
+				props.aggregate_delay = atof(optarg);
+				break;
+			case 'A' :
+				tx_queue = atoi(optarg);
+				break;
+			case 'B' :
+				stats_name = optarg;
+				break;
+			case 'C' :
+				props.adaptive_timeouts = false;
+				break;
+			case 'D' :
+				props.input = optarg;
+				break;
+			case 'E' :
+				props.seed = atoi(optarg);
+				break;
+			case 'F' :
+				if(sscanf(optarg, "%u,%u", &props.erasure_k, &props.erasure_r) != 2)
+				{
+					fprintf(stderr,"error: %s, erasure must be given as K,R\n", argv[0]);
+					exit(-1);
+				}
 				break;
 
 		}
@@ -279,6 +314,16 @@ int main (int argc, char **argv)
 	}
 
 
+	// switch clocks before the event log starts its writer thread
+	if(tsc_clock && !timer_enable_tsc())
+		std::cout << "TSC clock not available. Using CLOCK_MONOTONIC." << std::endl;
+	std::ostringstream filename;
+	time_t t = time(0);
+	struct tm * now = localtime(&t);
+	filename << "bs-" << now->tm_mon + 1 << ":" << now->tm_mday << ":" << now->tm_hour << ":" << now->tm_min << ".evlog";
+	evlog event_log = evlog_create(filename.str().c_str(), EVLOG_SOURCE_BASESTATION);
+	evlog_write(event_log, EVLOG_START, 0, 0, 0, 0, 0);
+
 	std::cout << "tx freq: " << tx_frequency << std::endl;
 	std::cout << "rx freq: " << rx_frequency << std::endl;
 
@@ -287,162 +332,87 @@ int main (int argc, char **argv)
 	if (cp_len == 0 || cp_len > M) {
 		fprintf(stderr,"error: %s, cyclic prefix must be in (0,M]\n", argv[0]);
 		exit(1);
-	} else if (ms == LIQUID_MODEM_UNKNOWN) {
+	} else if (props.ms == LIQUID_MODEM_UNKNOWN) {
 		fprintf(stderr,"error: %s, unknown/unsupported mod. scheme\n", argv[0]);
 		exit(-1);
-	} else if (fec0 == LIQUID_FEC_UNKNOWN) {
+	} else if (props.fec0 == LIQUID_FEC_UNKNOWN) {
 		fprintf(stderr,"error: %s, unknown/unsupported inner fec scheme\n", argv[0]);
 		exit(-1);
-	} else if (fec1 == LIQUID_FEC_UNKNOWN) {
+	} else if (props.fec1 == LIQUID_FEC_UNKNOWN) {
 		fprintf(stderr,"error: %s, unknown/unsupported outer fec scheme\n", argv[0]);
 		exit(-1);
+	} else if (props.payload_len == 0 || props.payload_len > 65535) {
+		fprintf(stderr,"error: %s, payload length must be in [1,65535]\n", argv[0]);
+		exit(-1);
+	} else if (props.window_size == 0 || props.window_size > 32768) {
+		fprintf(stderr,"error: %s, window must be in [1,32768]\n", argv[0]);
+		exit(-1);
+	} else if (props.num_uavs == 0 || props.num_uavs > SESSION_MAX) {
+		fprintf(stderr,"error: %s, number of uavs must be in [1,%u]\n", argv[0], SESSION_MAX);
+		exit(-1);
+	} else if (props.scheduler == SCHEDULER_UNKNOWN) {
+		fprintf(stderr,"error: %s, scheduler must be rr or pf\n", argv[0]);
+		exit(-1);
+	} else if (props.msg_len > 0 && props.msg_len + AGGREGATOR_PREFIX_LEN > props.payload_len) {
+		fprintf(stderr,"error: %s, messages must fit in a frame (msg-len + %u <= payload-len)\n", argv[0], AGGREGATOR_PREFIX_LEN);
+		exit(-1);
+	} else if (props.erasure_k > ERASURE_MAX_K || props.erasure_r > ERASURE_MAX_R || (props.erasure_k == 0) != (props.erasure_r == 0)) {
+		fprintf(stderr,"error: %s, erasure K must be in [1,%u] and R in [1,%u], or both 0\n", argv[0], ERASURE_MAX_K, ERASURE_MAX_R);
+		exit(-1);
+	} else if (props.erasure_k > 0 && props.payload_len + ERASURE_OVERHEAD > 65535) {
+		fprintf(stderr,"error: %s, repair frames need payload length <= %u\n", argv[0], 65535 - ERASURE_OVERHEAD);
+		exit(-1);
+	} else if (props.input != NULL && strcmp(props.input, "-") == 0 && props.num_uavs > 1) {
+		fprintf(stderr,"error: %s, stdin can only be sent to one uav\n", argv[0]);
+		exit(-1);
 	}
 
-	// create transceiver object
-	unsigned char * p = NULL;   // default subcarrier allocation
-	ofdmtxrx txcvr(M, cp_len, taper_len, p, callback, NULL);
-
-	// set properties
-	txcvr.set_tx_freq(tx_frequency);
-	txcvr.set_tx_rate(bandwidth);
-	txcvr.set_tx_gain_soft(txgain_dB);
-	txcvr.set_tx_gain_uhd(uhd_txgain);
+	bsnode bs = bsnode_create(&props, event_log);
 
-	txcvr.set_rx_freq(rx_frequency);
-	txcvr.set_rx_rate(bandwidth);
-	txcvr.set_rx_gain_uhd(uhd_rxgain);
+	// publish counters while the link runs
+	linkstats stats = strcmp(stats_name, "none") != 0 ?
+		linkstats_create(stats_name, LINKSTATS_SOURCE_BASESTATION, 0.5f, fill_stats, (void*)bs) : NULL;
 
+	// create transceiver object
+	unsigned char * p = NULL;   // default subcarrier allocation
+	usrp_transceiver radio(M, cp_len, taper_len, p, bsnode_callback, (void*)bs);
 
-	txcvr.start_rx();
-	// data arrays
-	unsigned char header[8];
-	unsigned char payload[payload_len];
+	// encode and send frames on their own thread unless disabled
+	pipelined_transceiver * pipeline = tx_queue > 0 ? new pipelined_transceiver(&radio, tx_queue, 0) : NULL;
+	transceiver * txcvr = pipeline != NULL ? (transceiver*)pipeline : (transceiver*)&radio;
 
+	// set properties
+	txcvr->set_tx_freq(tx_frequency);
+	txcvr->set_tx_rate(bandwidth);
+	txcvr->set_tx_gain_soft(txgain_dB);
+	txcvr->set_tx_gain_uhd(uhd_txgain);
 
-	timer pid_timer = timer_create();
-	timer_tic(pid_timer);
+	txcvr->set_rx_freq(rx_frequency);
+	txcvr->set_rx_rate(bandwidth);
+	txcvr->set_rx_gain_uhd(uhd_rxgain);
 
-	unsigned int id;
-	unsigned int i;
-	bool first_away = false;
-	packet pk;
-	packet pk2;
-	std::ostringstream msg;
-	while (pid<num_frames || transmitted_packets.size() > 0) 
-	{
-		if(timer_toc(pid_timer) > response_timeout)
-		{
-			state = READY_TO_TX;
-		}
-		if(state == READY_TO_TX)
-		{
-			
-			std::list<packet>::iterator it;
-			lock(&retransmit_packets_mutex);
-			for(it = transmitted_packets.begin(); it != transmitted_packets.end(); it++)
-			{
-				if(timer_toc((*it).send_timer) > packet_timeout)
-				{
-					timer_tic((*it).send_timer);
-					retransmit_packets.push_back((*it).id);
-					timeouts++;
-				}
-			}
-			while(retransmit_packets.size() > 0)
-			{
-				id = retransmit_packets.front();
-				retransmit_packets.pop_front();
-				pk2.id = id;
-				std::list<packet>::iterator iter = std::find(transmitted_packets.begin(), transmitted_packets.end(), pk2);
-				if(iter != transmitted_packets.end())
-				{
-					
-					(*iter).tx_attempts++;
-					header[0] = (id >> 8) & 0xff;
-					header[1] = (id     ) & 0xff;
-					header[2] = (*iter).tx_attempts;
-					for (i=3; i<8; i++)
-						header[i] = rand() & 0xff;
-
-					for (i=0; i<payload_len; i++)
-						payload[i] = rand() & 0xff;
-
-					if(verbose)std::cout << "re-tx packet id: " << id << std::endl;
-					txcvr.transmit_packet(header, (*iter).data, payload_len, ms, fec0, fec1);
-					msg.str("");
-					msg.clear();
-					msg << "tx id: " << (*iter).id << ", attempt: " << (*iter).tx_attempts;
-					log(msg.str());
-					state = WAITING_FOR_ACK;
-					timer_tic(pid_timer);
+	txcvr->start_rx();
+	bsnode_run(bs, txcvr);
 
-				}
-			}
-			unlock(&retransmit_packets_mutex);
-			if(state == READY_TO_TX)
-			{
-				if(pid < num_frames)
-				{
-					if (verbose)
-						printf("tx packet id: %6u\n", pid);
-
-					// write header (first two bytes packet ID, remaining are random)
-					header[0] = (pid >> 8) & 0xff;
-					header[1] = (pid     ) & 0xff;
-					header[2] = 1;
-					for (i=3; i<8; i++)
-						header[i] = rand() & 0xff;
-
-					// initialize payload
-					for (i=0; i<payload_len; i++)
-						payload[i] = rand() & 0xff;
-					pk.id = pid;
-					pk.tx_attempts = 1;
-					memcpy(pk.data, payload, payload_len);
-					pk.send_timer = timer_create();
-					timer_tic(pk.send_timer);
-					lock(&transmitted_packets_mutex);
-					transmitted_packets.push_back(pk);
-					// transmit frame
-					txcvr.transmit_packet(header, payload, payload_len, ms, fec0, fec1);
-					msg.str("");
-					msg.clear();
-					msg << "tx id: " << pk.id << ", attempt: " << pk.tx_attempts;
-					log(msg.str());
-					pid++;
-					timer_tic(pid_timer);
-					state = WAITING_FOR_ACK;
-					if(!first_away)first_away = true;
-					unlock(&transmitted_packets_mutex);
-				}
-			}
-		}
-	} // packet loop
+	// send whatever is still queued
+	delete pipeline;
 
 	// sleep for a small amount of time to allow USRP buffers
 	// to flush
 
 	usleep(200000);
 
-	txcvr.stop_rx();
+	radio.stop_rx();
 	//finished
 	printf("usrp data transfer complete\n");
 
 
-	std::cout << "Received " << received_acks << " acks." << std::endl;
-	std::cout << "Received " << received_nacks << " nacks." << std::endl;
-	std::cout << timeouts << " packets timed out and were retransmitted." << std::endl;
+	linkstats_destroy(stats);
+	bsnode_print_stats(bs);
 	printf("done.\n");
-	log("Base station done");
-	std::ostringstream filename;
-	time_t t = time(0);
-	struct tm * now = localtime(&t);
-	filename << "bs-" << now->tm_mon + 1 << ":" << now->tm_mday << ":" << now->tm_hour << ":" << now->tm_min << ".log";
-	std::ofstream log_file;
-	log_file.open(filename.str().c_str());
-	log_file << log_string << std::endl;
-	log_file.close();
+	evlog_write(event_log, EVLOG_DONE, 0, 0, 0, 0, 0);
+	evlog_destroy(event_log);
+	bsnode_destroy(bs);
 	timer_destroy(program_timer);
 	return 0;
 }
-
@@ -0,0 +1,393 @@
+//
+// LinkBench
+//
+// Throughput and latency benchmark of the ARQ link. Runs the base
+// station and one UAV in one process over the channel emulator for
+// every combination of the payload lengths, modulation schemes, FEC
+// schemes and frame loss rates given, and writes one CSV row of
+// results per combination, so runs can be compared over time.
+//
+// Two CPU figures are written: cpu_s covers the whole process, so it
+// includes the channel emulation and the PHY of both ends, while
+// bs_cpu_s covers only the base station's protocol thread, which with
+// a transmit queue no longer encodes frames itself.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <liquid/liquid.h>
+
+#include "emulator.h"
+#include "txpipeline.h"
+#include "event.h"
+#include "bsnode.h"
+#include "uavnode.h"
+
+void usage() {
+	printf("Benchmark matrix (comma-separated lists):\n");
+	printf("  --payload-lens			Set the payload lengths to run\n");
+	printf("								[Default: 256,1024,4096]\n");
+	printf("  --mod-schemes				Set the modulation schemes to run\n");
+	printf("								[Default: bpsk,qpsk,qam16]\n");
+	printf("  --inner-fecs				Set the inner FEC schemes to run\n");
+	printf("								[Default: none,v29p23]\n");
+	printf("  --outer-fecs				Set the outer FEC schemes to run\n");
+	printf("								[Default: rs8]\n");
+	printf("  --loss-rates				Set the probabilities a frame is lost to run\n");
+	printf("								[Default: 0,0.05,0.2]\n");
+	printf("Link options:\n");
+	printf("  --num-packets				Set the number of packets sent in each run\n");
+	printf("								[Default: 200]\n");
+	printf("  --window				Set the number of unacknowledged packets allowed in flight\n");
+	printf("								[Default: 32]\n");
+	printf("  --retransmit-timeout			Set the time to wait before retransmitting packets\n");
+	printf("								[Default: 0.1 seconds]\n");
+	printf("  --response-timeout			Set the time to wait for a response\n");
+	printf("								[Default: 0.05 seconds]\n");
+	printf("  --fixed-timeouts			Keep both timeouts as given instead of starting from them and\n");
+	printf("					adapting them to the measured ack round-trip time\n");
+	printf("								[Default: false]\n");
+	printf("  --tx-queue				Set the number of frames queued for the transmit thread\n");
+	printf("								[Default: 2]\n");
+	printf("  --tx-workers				Set the number of threads encoding frames ahead\n");
+	printf("								[Default: 0]\n");
+	printf("  --snr					Set the signal-to-noise ratio\n");
+	printf("								[Default: 30 dB]\n");
+	printf("  --seed				Set the seed of the payloads and the channel's random draws\n");
+	printf("								[Default: 1]\n");
+	printf("  --time-limit				Give up on a run after this long\n");
+	printf("								[Default: 60 seconds]\n");
+	printf("Results:\n");
+	printf("  cpu_s and cpu_ns_per_byte count every thread, channel emulation and both\n");
+	printf("  ends' frame sync included; bs_cpu_s and bs_cpu_ns_per_byte count only the\n");
+	printf("  base station's protocol thread (frame encoding too when --tx-queue is 0)\n");
+	printf("Miscellaneous options:\n");
+	printf("  --output				Write results to this file instead of stdout\n");
+	printf("  --help				Display this help message\n");
+	exit(0);
+}
+
+// one combination of the matrix
+struct bench_case_s {
+	unsigned int payload_len;
+	std::string mod;
+	std::string fec0;
+	std::string fec1;
+	float frame_loss;
+};
+
+// link settings shared by every run
+struct bench_props_s {
+	bsnode_props_s bs;
+	channel_props_s channel;
+	unsigned int tx_queue;
+	unsigned int tx_workers;
+	unsigned int seed;
+	float time_limit;
+};
+
+struct uav_thread_args {
+	uavnode uav;
+	transceiver * txcvr;
+};
+
+// uav main loop, run beside the base station
+void * uav_thread(void * _arg)
+{
+	uav_thread_args * args = (uav_thread_args*)_arg;
+	uavnode_run(args->uav, args->txcvr);
+	return NULL;
+}
+
+// cpu time used by the process (CLOCK_PROCESS_CPUTIME_ID) or the
+// calling thread (CLOCK_THREAD_CPUTIME_ID) [s]
+double cpu_time(clockid_t _clock)
+{
+	struct timespec ts;
+	clock_gettime(_clock, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+struct bs_thread_args {
+	bsnode bs;
+	transceiver * txcvr;
+	event done;
+	double cpu;		// cpu time of the main loop [s]
+};
+
+// base station main loop; raises done when it returns
+void * bs_thread(void * _arg)
+{
+	bs_thread_args * args = (bs_thread_args*)_arg;
+	double cpu_start = cpu_time(CLOCK_THREAD_CPUTIME_ID);
+	bsnode_run(args->bs, args->txcvr);
+	args->cpu = cpu_time(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+	event_signal(args->done);
+	return NULL;
+}
+
+// split comma-separated list
+std::vector<std::string> split(const char * _list)
+{
+	std::vector<std::string> items;
+	std::stringstream ss(_list);
+	std::string item;
+	while (std::getline(ss, item, ','))
+		if (!item.empty())
+			items.push_back(item);
+	return items;
+}
+
+// run one combination and write its row of results
+void run(const bench_props_s * _props, const bench_case_s * _case, FILE * _out)
+{
+	bsnode_props_s bs_props = _props->bs;
+	bs_props.payload_len = _case->payload_len;
+	bs_props.seed = _props->seed;
+	bs_props.ms = liquid_getopt_str2mod(_case->mod.c_str());
+	bs_props.fec0 = liquid_getopt_str2fec(_case->fec0.c_str());
+	bs_props.fec1 = liquid_getopt_str2fec(_case->fec1.c_str());
+	channel_props_s channel = _props->channel;
+	channel.frame_loss = _case->frame_loss;
+
+	uavnode_props_s uav_props;
+	uavnode_props_init_default(&uav_props);
+	uav_props.rx_timeout = _props->time_limit;
+
+	bsnode bs = bsnode_create(&bs_props, NULL);
+	uavnode uav = uavnode_create(&uav_props, NULL);
+
+	unsigned int M = 48;
+	unsigned int cp_len = 6;
+	unsigned int taper_len = 4;
+	emulated_transceiver bs_txcvr(M, cp_len, taper_len, NULL, bsnode_callback, (void*)bs);
+	emulated_transceiver uav_txcvr(M, cp_len, taper_len, NULL, uavnode_callback, (void*)uav);
+	bs_txcvr.set_tx_freq(462e6);
+	bs_txcvr.set_rx_freq(464e6);
+	uav_txcvr.set_tx_freq(464e6);
+	uav_txcvr.set_rx_freq(462e6);
+	bs_txcvr.connect(&uav_txcvr, &channel, _props->seed);
+	uav_txcvr.connect(&bs_txcvr, &channel, _props->seed + 1);
+	bs_txcvr.start_rx();
+	uav_txcvr.start_rx();
+
+	pipelined_transceiver * pipeline = _props->tx_queue > 0 ?
+		new pipelined_transceiver(&bs_txcvr, _props->tx_queue, _props->tx_workers) : NULL;
+
+	double cpu_start = cpu_time(CLOCK_PROCESS_CPUTIME_ID);
+	uav_thread_args uav_args = {uav, &uav_txcvr};
+	bs_thread_args bs_args = {bs, pipeline != NULL ? (transceiver*)pipeline : (transceiver*)&bs_txcvr, event_create(), 0.0};
+	pthread_t uav_process;
+	pthread_t bs_process;
+	pthread_create(&uav_process, NULL, uav_thread, (void*)&uav_args);
+	pthread_create(&bs_process, NULL, bs_thread, (void*)&bs_args);
+
+	// a link too poor to ever finish is cut off
+	bool completed = event_wait(bs_args.done, _props->time_limit);
+	if(!completed)
+		bsnode_stop(bs);
+	pthread_join(bs_process, NULL);
+	delete pipeline;
+	uavnode_stop(uav);
+	pthread_join(uav_process, NULL);
+	double cpu = cpu_time(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+
+	bs_txcvr.stop_rx();
+	uav_txcvr.stop_rx();
+
+	bsnode_stats_s s;
+	bsnode_get_stats(bs, &s);
+	histogram_s rtt;
+	bsnode_get_rtt(bs, &rtt);
+	double bytes = s.num_bytes_delivered;
+	double goodput = s.runtime > 0 ? bytes * 8 / s.runtime : 0;
+	double frame_rate = s.runtime > 0 ? s.num_transmissions / s.runtime : 0;
+	double retx_ratio = s.num_transmissions > 0 ?
+		(double)(s.num_transmissions - s.num_delivered) / s.num_transmissions : 0;
+	fprintf(_out, "%u,%s,%s,%s,%g,%d,%u,%u,%.4f,%.3f,%.1f,%.3f,%.3f,%.3f,%.4f,%.4f,%.1f,%.4f,%.1f\n",
+			_case->payload_len, _case->mod.c_str(), _case->fec0.c_str(), _case->fec1.c_str(),
+			_case->frame_loss, completed ? 1 : 0, s.num_delivered, s.num_transmissions,
+			s.runtime, goodput*1e-3, frame_rate,
+			histogram_percentile(&rtt, 0.5f)*1e3f, histogram_percentile(&rtt, 0.9f)*1e3f,
+			histogram_percentile(&rtt, 0.99f)*1e3f, retx_ratio, cpu,
+			bytes > 0 ? cpu*1e9 / bytes : 0, bs_args.cpu,
+			bytes > 0 ? bs_args.cpu*1e9 / bytes : 0);
+	fflush(_out);
+
+	event_destroy(bs_args.done);
+	bsnode_destroy(bs);
+	uavnode_destroy(uav);
+}
+
+int main (int argc, char **argv)
+{
+	bench_props_s props;
+	bsnode_props_init_default(&props.bs);
+	props.bs.num_frames = 200;
+	props.bs.window_size = 32;
+	props.bs.packet_timeout = 0.1f;
+	props.bs.response_timeout = 0.05f;
+	channel_props_init_default(&props.channel);
+	props.tx_queue = 2;
+	props.tx_workers = 0;
+	props.seed = 1;
+	props.time_limit = 60.0f;
+
+	std::vector<std::string> payload_lens = split("256,1024,4096");
+	std::vector<std::string> mods = split("bpsk,qpsk,qam16");
+	std::vector<std::string> fec0s = split("none,v29p23");
+	std::vector<std::string> fec1s = split("rs8");
+	std::vector<std::string> losses = split("0,0.05,0.2");
+	const char * output = NULL;
+
+	int c;
+	static struct option long_options[] = {
+		{"payload-lens",		required_argument, 0, 'a'},
+		{"mod-schemes",			required_argument, 0, 'b'},
+		{"inner-fecs",			required_argument, 0, 'c'},
+		{"outer-fecs",			required_argument, 0, 'd'},
+		{"loss-rates",			required_argument, 0, 'e'},
+		{"num-packets",			required_argument, 0, 'f'},
+		{"window",				required_argument, 0, 'g'},
+		{"retransmit-timeout",	required_argument, 0, 'h'},
+		{"response-timeout",	required_argument, 0, 'i'},
+		{"tx-queue",			required_argument, 0, 'j'},
+		{"tx-workers",			required_argument, 0, 'k'},
+		{"snr",					required_argument, 0, 'l'},
+		{"seed",				required_argument, 0, 'm'},
+		{"time-limit",			required_argument, 0, 'n'},
+		{"output",				required_argument, 0, 'o'},
+		{"help",				no_argument,       0, 'p'},
+		{"fixed-timeouts",		no_argument,       0, 'q'},
+		{0, 0, 0, 0},
+	};
+	int option_index = 0;
+
+	while (1)
+	{
+		c = getopt_long(argc, argv, "", long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c)
+		{
+			case 'a' :
+				payload_lens = split(optarg);
+				break;
+			case 'b' :
+				mods = split(optarg);
+				break;
+			case 'c' :
+				fec0s = split(optarg);
+				break;
+			case 'd' :
+				fec1s = split(optarg);
+				break;
+			case 'e' :
+				losses = split(optarg);
+				break;
+			case 'f' :
+				props.bs.num_frames = atoi(optarg);
+				break;
+			case 'g' :
+				props.bs.window_size = atoi(optarg);
+				break;
+			case 'h' :
+				props.bs.packet_timeout = atof(optarg);
+				break;
+			case 'i' :
+				props.bs.response_timeout = atof(optarg);
+				break;
+			case 'j' :
+				props.tx_queue = atoi(optarg);
+				break;
+			case 'k' :
+				props.tx_workers = atoi(optarg);
+				break;
+			case 'l' :
+				props.channel.snr_dB = atof(optarg);
+				break;
+			case 'm' :
+				props.seed = atoi(optarg);
+				break;
+			case 'n' :
+				props.time_limit = atof(optarg);
+				break;
+			case 'o' :
+				output = optarg;
+				break;
+			case 'q' :
+				props.bs.adaptive_timeouts = false;
+				break;
+			case 'p' :
+			default :
+				usage();
+		}
+	}
+
+	// check the whole matrix before spending time on any of it
+	unsigned int i;
+	for (i=0; i<payload_lens.size(); i++) {
+		int len = atoi(payload_lens[i].c_str());
+		if (len <= 0 || len > 65535) {
+			fprintf(stderr,"error: %s, payload length must be in [1,65535]\n", argv[0]);
+			exit(-1);
+		}
+	}
+	for (i=0; i<mods.size(); i++) {
+		if (liquid_getopt_str2mod(mods[i].c_str()) == LIQUID_MODEM_UNKNOWN) {
+			fprintf(stderr,"error: %s, unknown/unsupported mod. scheme '%s'\n", argv[0], mods[i].c_str());
+			exit(-1);
+		}
+	}
+	for (i=0; i<fec0s.size() + fec1s.size(); i++) {
+		const std::string & fec = i < fec0s.size() ? fec0s[i] : fec1s[i - fec0s.size()];
+		if (liquid_getopt_str2fec(fec.c_str()) == LIQUID_FEC_UNKNOWN) {
+			fprintf(stderr,"error: %s, unknown/unsupported fec scheme '%s'\n", argv[0], fec.c_str());
+			exit(-1);
+		}
+	}
+	if (props.bs.window_size == 0 || props.bs.window_size > 32768) {
+		fprintf(stderr,"error: %s, window must be in [1,32768]\n", argv[0]);
+		exit(-1);
+	}
+
+	FILE * out = stdout;
+	if (output != NULL && (out = fopen(output, "w")) == NULL) {
+		fprintf(stderr,"error: %s, could not open '%s'\n", argv[0], output);
+		exit(-1);
+	}
+	fprintf(out, "payload_len,mod,inner_fec,outer_fec,frame_loss,completed,frames_delivered,transmissions,"
+			"runtime_s,goodput_kbps,frames_per_s,rtt_p50_ms,rtt_p90_ms,rtt_p99_ms,retx_ratio,cpu_s,cpu_ns_per_byte,"
+			"bs_cpu_s,bs_cpu_ns_per_byte\n");
+
+	unsigned int num_runs = payload_lens.size() * mods.size() * fec0s.size() * fec1s.size() * losses.size();
+	unsigned int n = 0;
+	unsigned int a, b, d, e, f;
+	for (a=0; a<payload_lens.size(); a++)
+	for (b=0; b<mods.size(); b++)
+	for (d=0; d<fec0s.size(); d++)
+	for (e=0; e<fec1s.size(); e++)
+	for (f=0; f<losses.size(); f++)
+	{
+		bench_case_s bc;
+		bc.payload_len = atoi(payload_lens[a].c_str());
+		bc.mod = mods[b];
+		bc.fec0 = fec0s[d];
+		bc.fec1 = fec1s[e];
+		bc.frame_loss = atof(losses[f].c_str());
+		fprintf(stderr, "run %u/%u: %u bytes, %s, %s/%s, loss %g\n", ++n, num_runs,
+				bc.payload_len, bc.mod.c_str(), bc.fec0.c_str(), bc.fec1.c_str(), bc.frame_loss);
+		run(&props, &bc, out);
+	}
+
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
@@ -0,0 +1,445 @@
+//
+// LinkSim
+//
+// Runs the base station and its UAVs in one process over the software
+// channel emulator, so the ARQ link can be exercised without radios.
+//
+
+#include <iostream>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <liquid/liquid.h>
+
+#include "emulator.h"
+#include "txpipeline.h"
+#include "bsnode.h"
+#include "aggregator.h"
+#include "erasure.h"
+#include "uavnode.h"
+
+void usage() {
+	printf("Link options:\n");
+	printf("  --num-uavs				Set the number of UAVs served by the base station\n");
+	printf("								[Default: 1]\n");
+	printf("  --scheduler				Set how airtime is shared between UAVs: rr or pf\n");
+	printf("								[Default: rr (round-robin)]\n");
+	printf("  --num-packets				Set the number of packets to send to each UAV\n");
+	printf("								[Default: 1000]\n");
+	printf("  --payload-len				Set the size of each packet\n");
+	printf("								[Default: 4096 bytes]\n");
+	printf("  --mod-scheme				Set the modulation scheme to use for transmission\n");
+	printf("								[Default: BPSK]\n");
+	printf("  --inner-fec				Set the inner FEC scheme\n");
+	printf("								[Default: none]\n");
+	printf("  --outer-fec				Set the outer FEC scheme\n");
+	printf("								[Default: RS_M8]\n");
+	printf("  --rate-adapt				Choose modulation and FEC per packet from the EVM the UAV\n");
+	printf("					reports, overriding the three options above\n");
+	printf("								[Default: false]\n");
+	printf("  --window				Set the number of unacknowledged packets allowed in flight\n");
+	printf("								[Default: 1 (stop-and-wait)]\n");
+	printf("  --erasure				Follow every K new packets with R erasure repair frames, from\n");
+	printf("					which each UAV rebuilds up to R lost ones (K,R; 0,0: off)\n");
+	printf("								[Default: 0,0]\n");
+	printf("  --harq-buffers				Keep up to N failed packets at each UAV and soft-combine retransmissions\n");
+	printf("								[Default: 0 (off)]\n");
+	printf("  --msg-len				Send messages of this many bytes, packed into frames of up to\n");
+	printf("					payload-len bytes, instead of full frames\n");
+	printf("								[Default: 0 (off)]\n");
+	printf("  --num-messages				Set the number of messages to send to each UAV\n");
+	printf("								[Default: 10000]\n");
+	printf("  --msg-rate				Set the messages offered per second to each UAV (0: all at once)\n");
+	printf("								[Default: 0]\n");
+	printf("  --aggregate-delay			Set the longest a message waits for others to share its frame\n");
+	printf("								[Default: 0.01 seconds]\n");
+	printf("  --input				Send the bytes of this file (- for stdin) to each UAV instead of\n");
+	printf("					random data; the run ends with the input\n");
+	printf("								[Default: none]\n");
+	printf("  --output				Write the data each UAV receives, in order, to this file\n");
+	printf("					(suffixed .N for UAV N when there are several)\n");
+	printf("								[Default: none]\n");
+	printf("  --retransmit-timeout			Set the time to wait before retransmitting packets\n");
+	printf("								[Default: 1.0 seconds]\n");
+	printf("  --response-timeout			Set the time to wait for a response\n");
+	printf("								[Default: 0.2 seconds]\n");
+	printf("  --fixed-timeouts			Keep both timeouts as given instead of starting from them and\n");
+	printf("					adapting them to the measured ack round-trip time\n");
+	printf("								[Default: false]\n");
+	printf("  --tx-queue				Set the number of frames queued for the base station's\n");
+	printf("					transmit thread (0: transmit from the protocol loop)\n");
+	printf("								[Default: 2]\n");
+	printf("  --tx-cache				Set the memory kept for samples of frames the base station\n");
+	printf("					may resend, in KiB (0: re-encode every retransmission)\n");
+	printf("								[Default: 16384]\n");
+	printf("  --tx-workers				Set the number of threads encoding queued frames ahead of\n");
+	printf("					the base station's transmit thread, with tx-queue above N\n");
+	printf("					(0: encode each frame as it is sent)\n");
+	printf("								[Default: 0]\n");
+	printf("Channel options:\n");
+	printf("  --snr					Set the signal-to-noise ratio\n");
+	printf("								[Default: 30 dB]\n");
+	printf("  --fading-K				Set the Rician K-factor of per-frame fading (negative disables)\n");
+	printf("								[Default: -1]\n");
+	printf("  --cfo					Set the carrier frequency offset\n");
+	printf("								[Default: 0 radians/sample]\n");
+	printf("  --frame-loss				Set the probability a frame is lost entirely\n");
+	printf("								[Default: 0]\n");
+	printf("  --realtime				Pace frames at the sample rate instead of running flat out\n");
+	printf("								[Default: false]\n");
+	printf("  --seed				Set the seed for payloads and channel draws\n");
+	printf("								[Default: 1]\n");
+	printf("OFDM options:\n");
+	printf("  --num-subcarriers			Set the number of OFDM subcarriers\n");
+	printf("								[Default: 48]\n");
+	printf("  --cyclic-prefix-len			Set the OFDM cyclic prefix length\n");
+	printf("								[Default: 6]\n");
+	printf("  --taper-len				Set the OFDM taper length\n");
+	printf("								[Default: 4]\n");
+	printf("Miscellaneous options:\n");
+	printf("  --verbose				Enable extra output\n");
+	printf("								[Default: false]\n");
+	printf("  --help				Display this help message\n");
+	exit(0);
+}
+
+struct uav_thread_args {
+	uavnode uav;
+	transceiver * txcvr;
+};
+
+// uav main loop, run beside the base station
+void * uav_thread(void * _arg)
+{
+	uav_thread_args * args = (uav_thread_args*)_arg;
+	uavnode_run(args->uav, args->txcvr);
+	return NULL;
+}
+
+int main (int argc, char **argv)
+{
+	// command-line options
+	bsnode_props_s bs_props;
+	bsnode_props_init_default(&bs_props);
+	uavnode_props_s uav_props;
+	uavnode_props_init_default(&uav_props);
+	channel_props_s channel;
+	channel_props_init_default(&channel);
+	unsigned int seed = 1;
+	const char * output = NULL;
+	unsigned int tx_queue = 2;          // frames queued for the bs tx thread
+	unsigned int tx_cache = 16384;      // bs frame cache [KiB]
+	unsigned int tx_workers = 0;        // bs encode threads
+
+	// ofdm properties
+	unsigned int M = 48;                // number of subcarriers
+	unsigned int cp_len = 6;            // cyclic prefix length
+	unsigned int taper_len = 4;         // taper length
+
+	int c;
+	static struct option long_options[] = {
+		{"num-packets",			required_argument, 0, 'a'},
+		{"payload-len",			required_argument, 0, 'b'},
+		{"mod-scheme",			required_argument, 0, 'c'},
+		{"inner-fec",			required_argument, 0, 'd'},
+		{"outer-fec",			required_argument, 0, 'e'},
+		{"window",				required_argument, 0, 'f'},
+		{"retransmit-timeout",	required_argument, 0, 'g'},
+		{"response-timeout",	required_argument, 0, 'h'},
+		{"snr",					required_argument, 0, 'i'},
+		{"fading-K",			required_argument, 0, 'j'},
+		{"cfo",					required_argument, 0, 'k'},
+		{"frame-loss",			required_argument, 0, 'l'},
+		{"realtime",			no_argument,       0, 'm'},
+		{"seed",				required_argument, 0, 'n'},
+		{"num-subcarriers",		required_argument, 0, 'o'},
+		{"cyclic-prefix-len",	required_argument, 0, 'p'},
+		{"taper-len",			required_argument, 0, 'q'},
+		{"verbose",				no_argument,       0, 'r'},
+		{"help",				no_argument,       0, 's'},
+		{"num-uavs",			required_argument, 0, 't'},
+		{"scheduler",			required_argument, 0, 'u'},
+		{"rate-adapt",			no_argument,       0, 'v'},
+		{"harq-buffers",		required_argument, 0, 'w'},
+		{"msg-len",			required_argument, 0, 'x'},
+		{"num-messages",		required_argument, 0, 'y'},
+		{"msg-rate",			required_argument, 0, 'z'},
+		{"aggregate-delay",	required_argument, 0, 'A'},
+		{"tx-queue",			required_argument, 0, 'B'},
+		{"tx-cache",			required_argument, 0, 'C'},
+		{"tx-workers",			required_argument, 0, 'D'},
+		{"fixed-timeouts",		no_argument,       0, 'E'},
+		{"input",				required_argument, 0, 'F'},
+		{"output",				required_argument, 0, 'G'},
+		{"erasure",				required_argument, 0, 'H'},
+		{0, 0, 0, 0},
+	};
+	int option_index = 0;
+
+	while (1)
+	{
+		c = getopt_long(argc, argv, "", long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c)
+		{
+			case 'a' :
+				bs_props.num_frames = atoi(optarg);
+				break;
+			case 'b' :
+				bs_props.payload_len = atoi(optarg);
+				break;
+			case 'c' :
+				bs_props.ms = liquid_getopt_str2mod(optarg);
+				break;
+			case 'd' :
+				bs_props.fec0 = liquid_getopt_str2fec(optarg);
+				break;
+			case 'e' :
+				bs_props.fec1 = liquid_getopt_str2fec(optarg);
+				break;
+			case 'f' :
+				bs_props.window_size = atoi(optarg);
+				break;
+			case 'g' :
+				bs_props.packet_timeout = atof(optarg);
+				break;
+			case 'h' :
+				bs_props.response_timeout = atof(optarg);
+				break;
+			case 'i' :
+				channel.snr_dB = atof(optarg);
+				break;
+			case 'j' :
+				channel.fading_K = atof(optarg);
+				break;
+			case 'k' :
+				channel.cfo = atof(optarg);
+				break;
+			case 'l' :
+				channel.frame_loss = atof(optarg);
+				break;
+			case 'm' :
+				channel.realtime = 1;
+				break;
+			case 'n' :
+				seed = atoi(optarg);
+				break;
+			case 'o' :
+				M = atoi(optarg);
+				break;
+			case 'p' :
+				cp_len = atoi(optarg);
+				break;
+			case 'q' :
+				taper_len = atoi(optarg);
+				break;
+			case 'r' :
+				bs_props.verbose = true;
+				uav_props.verbose = true;
+				break;
+			case 's' :
+				usage();
+				break;
+			case 't' :
+				bs_props.num_uavs = atoi(optarg);
+				break;
+			case 'u' :
+				bs_props.scheduler = scheduler_str2type(optarg);
+				break;
+			case 'v' :
+				bs_props.rate_adapt = true;
+				break;
+			case 'w' :
+				uav_props.harq_buffers = atoi(optarg);
+				break;
+			case 'x' :
+				bs_props.msg_len = atoi(optarg);
+				break;
+			case 'y' :
+				bs_props.num_messages = atoi(optarg);
+				break;
+			case 'z' :
+				bs_props.msg_rate = atof(optarg);
+				break;
+			case 'A' :
+				bs_props.aggregate_delay = atof(optarg);
+				break;
+			case 'B' :
+				tx_queue = atoi(optarg);
+				break;
+			case 'C' :
+				tx_cache = atoi(optarg);
+				break;
+			case 'D' :
+				tx_workers = atoi(optarg);
+				break;
+			case 'E' :
+				bs_props.adaptive_timeouts = false;
+				break;
+			case 'F' :
+				bs_props.input = optarg;
+				break;
+			case 'G' :
+				output = optarg;
+				break;
+			case 'H' :
+				if(sscanf(optarg, "%u,%u", &bs_props.erasure_k, &bs_props.erasure_r) != 2)
+				{
+					fprintf(stderr,"error: %s, erasure must be given as K,R\n", argv[0]);
+					exit(-1);
+				}
+				break;
+		}
+	}
+
+	if (cp_len == 0 || cp_len > M) {
+		fprintf(stderr,"error: %s, cyclic prefix must be in (0,M]\n", argv[0]);
+		exit(1);
+	} else if (bs_props.ms == LIQUID_MODEM_UNKNOWN) {
+		fprintf(stderr,"error: %s, unknown/unsupported mod. scheme\n", argv[0]);
+		exit(-1);
+	} else if (bs_props.fec0 == LIQUID_FEC_UNKNOWN) {
+		fprintf(stderr,"error: %s, unknown/unsupported inner fec scheme\n", argv[0]);
+		exit(-1);
+	} else if (bs_props.fec1 == LIQUID_FEC_UNKNOWN) {
+		fprintf(stderr,"error: %s, unknown/unsupported outer fec scheme\n", argv[0]);
+		exit(-1);
+	} else if (bs_props.payload_len == 0 || bs_props.payload_len > 65535) {
+		fprintf(stderr,"error: %s, payload length must be in [1,65535]\n", argv[0]);
+		exit(-1);
+	} else if (bs_props.window_size == 0 || bs_props.window_size > 32768) {
+		fprintf(stderr,"error: %s, window must be in [1,32768]\n", argv[0]);
+		exit(-1);
+	} else if (bs_props.num_uavs == 0 || bs_props.num_uavs > SESSION_MAX) {
+		fprintf(stderr,"error: %s, number of uavs must be in [1,%u]\n", argv[0], SESSION_MAX);
+		exit(-1);
+	} else if (bs_props.scheduler == SCHEDULER_UNKNOWN) {
+		fprintf(stderr,"error: %s, scheduler must be rr or pf\n", argv[0]);
+		exit(-1);
+	} else if (bs_props.msg_len > 0 && bs_props.msg_len + AGGREGATOR_PREFIX_LEN > bs_props.payload_len) {
+		fprintf(stderr,"error: %s, messages must fit in a frame (msg-len + %u <= payload-len)\n", argv[0], AGGREGATOR_PREFIX_LEN);
+		exit(-1);
+	} else if (bs_props.erasure_k > ERASURE_MAX_K || bs_props.erasure_r > ERASURE_MAX_R || (bs_props.erasure_k == 0) != (bs_props.erasure_r == 0)) {
+		fprintf(stderr,"error: %s, erasure K must be in [1,%u] and R in [1,%u], or both 0\n", argv[0], ERASURE_MAX_K, ERASURE_MAX_R);
+		exit(-1);
+	} else if (bs_props.erasure_k > 0 && bs_props.payload_len + ERASURE_OVERHEAD > 65535) {
+		fprintf(stderr,"error: %s, repair frames need payload length <= %u\n", argv[0], 65535 - ERASURE_OVERHEAD);
+		exit(-1);
+	} else if (bs_props.input != NULL && strcmp(bs_props.input, "-") == 0 && bs_props.num_uavs > 1) {
+		fprintf(stderr,"error: %s, stdin can only be sent to one uav\n", argv[0]);
+		exit(-1);
+	}
+	srand(seed);
+	bs_props.seed = seed;
+	// the uavs keep every packet a block's repair frames may need
+	if(bs_props.erasure_k > 0)
+		uav_props.erasure_window = bs_props.window_size + bs_props.erasure_k;
+
+	unsigned int num_uavs = bs_props.num_uavs;
+	unsigned int u;
+	bsnode bs = bsnode_create(&bs_props, NULL);
+	uavnode * uavs = (uavnode*) malloc(num_uavs*sizeof(uavnode));
+	std::string output_name;
+	for(u=0; u<num_uavs; u++)
+	{
+		uav_props.session = u;
+		if(output != NULL)
+		{
+			output_name = num_uavs > 1 ? std::string(output) + "." + std::to_string(u) : output;
+			uav_props.output = output_name.c_str();
+		}
+		uavs[u] = uavnode_create(&uav_props, NULL);
+	}
+
+	// one emulated radio per node; the base station's frames reach
+	// every uav and every uav's frames reach the base station, each
+	// over a channel of its own
+	unsigned char * p = NULL;   // default subcarrier allocation
+	emulated_transceiver bs_txcvr(M, cp_len, taper_len, p, bsnode_callback, (void*)bs);
+	bs_txcvr.set_tx_freq(462e6);
+	bs_txcvr.set_rx_freq(464e6);
+	bs_txcvr.set_tx_cache((size_t)tx_cache << 10);
+	bs_txcvr.set_tx_rate(500e3f);
+	emulated_transceiver ** uav_txcvrs = (emulated_transceiver**) malloc(num_uavs*sizeof(emulated_transceiver*));
+	for(u=0; u<num_uavs; u++)
+	{
+		uav_txcvrs[u] = new emulated_transceiver(M, cp_len, taper_len, p, uavnode_callback, (void*)uavs[u]);
+		uav_txcvrs[u]->set_tx_freq(464e6);
+		uav_txcvrs[u]->set_rx_freq(462e6);
+		uav_txcvrs[u]->set_tx_rate(500e3f);
+		bs_txcvr.connect(uav_txcvrs[u], &channel, seed + 2*u);
+		uav_txcvrs[u]->connect(&bs_txcvr, &channel, seed + 2*u + 1);
+	}
+
+	bs_txcvr.start_rx();
+	for(u=0; u<num_uavs; u++)
+		uav_txcvrs[u]->start_rx();
+
+	uav_thread_args * args = (uav_thread_args*) malloc(num_uavs*sizeof(uav_thread_args));
+	pthread_t * uav_processes = (pthread_t*) malloc(num_uavs*sizeof(pthread_t));
+	for(u=0; u<num_uavs; u++)
+	{
+		args[u].uav = uavs[u];
+		args[u].txcvr = uav_txcvrs[u];
+		pthread_create(&uav_processes[u], NULL, uav_thread, (void*)&args[u]);
+	}
+	pipelined_transceiver * pipeline = tx_queue > 0 ? new pipelined_transceiver(&bs_txcvr, tx_queue, tx_workers) : NULL;
+	bsnode_run(bs, pipeline != NULL ? (transceiver*)pipeline : (transceiver*)&bs_txcvr);
+	delete pipeline;
+	for(u=0; u<num_uavs; u++)
+	{
+		uavnode_stop(uavs[u]);
+		pthread_join(uav_processes[u], NULL);
+	}
+
+	bs_txcvr.stop_rx();
+	for(u=0; u<num_uavs; u++)
+		uav_txcvrs[u]->stop_rx();
+
+	// print results
+	bsnode_stats_s bs_stats;
+	bsnode_get_stats(bs, &bs_stats);
+	unsigned int frames_sent = bs_txcvr.get_num_frames_sent();
+	unsigned int frames_lost = bs_txcvr.get_num_frames_lost();
+	for(u=0; u<num_uavs; u++)
+	{
+		frames_sent += uav_txcvrs[u]->get_num_frames_sent();
+		frames_lost += uav_txcvrs[u]->get_num_frames_lost();
+	}
+	// bytes acknowledged over all sessions, so a run cut short or fed
+	// from an input file still reports what actually got through
+	float goodput = (bs_stats.runtime > 0) ?
+		(float)bs_stats.num_bytes_delivered * 8.0f / bs_stats.runtime :
+		0.0f;
+
+	printf("base station:\n");
+	bsnode_print_stats(bs);
+	printf("    transmissions       : %6u\n", bs_stats.num_transmissions);
+	printf("    run time            : %f s\n", bs_stats.runtime);
+	printf("    goodput             : %8.4f kbps\n", goodput*1e-3f);
+	for(u=0; u<num_uavs; u++)
+	{
+		printf("uav %u:\n", u);
+		uavnode_print_stats(uavs[u]);
+	}
+	printf("channel:\n");
+	printf("    frames sent         : %6u\n", frames_sent);
+	printf("    frames lost         : %6u\n", frames_lost);
+	printf("    resent from cache   : %6u\n", bs_txcvr.get_num_frames_cached());
+
+	bsnode_destroy(bs);
+	for(u=0; u<num_uavs; u++)
+	{
+		delete uav_txcvrs[u];
+		uavnode_destroy(uavs[u]);
+	}
+	free(uav_txcvrs);
+	free(uavs);
+	free(args);
+	free(uav_processes);
+	return 0;
+}
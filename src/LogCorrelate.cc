@@ -0,0 +1,670 @@
+//
+// LogCorrelate
+//
+// Join a base station log (bs-*.log) with a UAV log (uav-*.log), in the
+// text format LogDecode writes, packet by packet. For every packet of
+// the UAV's session it finds the one-way latency of the copy that got
+// through, the delivery latency from its first transmission, the ack
+// round-trip time, the attempts it took, and which transmissions were
+// lost; it prints percentiles and loss bursts and can write a CSV row
+// per packet. Both logs are mapped and walked in step by packet id, so
+// only a fixed window of packets is tracked however long the logs are.
+//
+// The base station stamps wall-clock time and the UAV the time since it
+// started, so one-way latencies are measured against the fastest packet
+// of the first window unless the clock offset is given.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "histogram.h"
+
+// attempts whose transmission time is kept per packet
+#define MAX_ATTEMPTS 16
+
+// longest loss burst counted on its own
+#define MAX_BURST 32
+
+// kinds of log line
+#define LINE_TX  0
+#define LINE_RX  1
+#define LINE_ACK 2
+
+void usage() {
+	printf("Usage: LogCorrelate [options] <bs.log> <uav.log>\n");
+	printf("  --session				Set the session of the UAV that wrote the UAV log\n");
+	printf("								[Default: the one in the UAV log]\n");
+	printf("  --window				Set the number of packet ids tracked at once\n");
+	printf("								[Default: 65536]\n");
+	printf("  --id-bits				Set the width of the packet ids in the logs, 16 or 32\n");
+	printf("								[Default: 16 until an id above 65535 appears]\n");
+	printf("  --offset				Set the UAV clock minus the base station clock [s]\n");
+	printf("								[Default: estimated from the fastest packet]\n");
+	printf("  --csv					Write one line per packet to this file\n");
+	printf("								[Default: none]\n");
+	printf("  --help				Display this help message\n");
+	exit(0);
+}
+
+// a mapped log and the packet line it is at
+struct logfile_s {
+	const char * name;
+	const char * data;
+	const char * pos;                   // start of the next line
+	const char * end;
+	unsigned int id_bits;               // width of the ids in the log
+	long long max_id;                   // highest unwrapped id so far, -1
+	                                    // before the first
+
+	// current line
+	int type;                           // LINE_*
+	long long time;                     // [ns]
+	long long id;                       // unwrapped
+	unsigned int attempt;
+	unsigned int session;
+};
+
+// map log _name
+void logfile_open(logfile_s * _f, const char * _name, unsigned int _id_bits)
+{
+	int fd = open(_name, O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) < 0)
+	{
+		fprintf(stderr,"error: LogCorrelate, could not open '%s'\n", _name);
+		exit(1);
+	}
+	_f->name = _name;
+	_f->data = NULL;
+	if(st.st_size > 0)
+	{
+		void * data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data == MAP_FAILED)
+		{
+			fprintf(stderr,"error: LogCorrelate, could not map '%s'\n", _name);
+			exit(1);
+		}
+		madvise(data, st.st_size, MADV_SEQUENTIAL);
+		_f->data = (const char*) data;
+	}
+	close(fd);
+	_f->pos = _f->data;
+	_f->end = _f->data + st.st_size;
+	_f->id_bits = _id_bits;
+	_f->max_id = -1;
+}
+
+// unmap log
+void logfile_close(logfile_s * _f)
+{
+	if(_f->data != NULL)
+		munmap((void*)_f->data, _f->end - _f->data);
+}
+
+// skip the literal _s at *_p; returns 0 if the text differs
+static int match(const char ** _p, const char * _end, const char * _s)
+{
+	const char * p = *_p;
+	while(*_s != '\0')
+	{
+		if(p == _end || *p != *_s)
+			return 0;
+		p++;
+		_s++;
+	}
+	*_p = p;
+	return 1;
+}
+
+// read a decimal number at *_p; returns 0 if there is none
+static int parse_uint(const char ** _p, const char * _end, unsigned long long * _v)
+{
+	const char * p = *_p;
+	unsigned long long v = 0;
+	while(p < _end && *p >= '0' && *p <= '9')
+		v = v*10 + (*p++ - '0');
+	if(p == *_p)
+		return 0;
+	*_p = p;
+	*_v = v;
+	return 1;
+}
+
+// extend a logged id to 64 bits: the nearest value with those low bits
+// to the highest id so far, which wraps with the ids
+static long long logfile_unwrap(logfile_s * _f, unsigned int _id)
+{
+	if(_id > 0xffff)
+		_f->id_bits = 32;
+	long long id = _id;
+	if(_f->max_id >= 0)
+	{
+		long long mod = 1LL << _f->id_bits;
+		long long d = (id - _f->max_id) & (mod - 1);
+		if(d >= mod/2)
+			d -= mod;
+		id = _f->max_id + d;
+	}
+	if(id > _f->max_id)
+		_f->max_id = id;
+	return id;
+}
+
+// move to the next tx, rx or ack line of session _session (any if
+// negative), skipping every other line; returns 0 at the end of the log
+int logfile_next(logfile_s * _f, int _session)
+{
+	unsigned long long v;
+	unsigned long long id;
+	while(_f->pos < _f->end)
+	{
+		const char * p = _f->pos;
+		const char * eol = (const char*) memchr(p, '\n', _f->end - p);
+		if(eol == NULL)
+			eol = _f->end;
+		_f->pos = eol + 1;
+
+		// "<seconds>.<fraction>:", then the event
+		if(!parse_uint(&p, eol, &v))
+			continue;
+		long long time = (long long)v * 1000000000LL;
+		if(p < eol && *p == '.')
+		{
+			long long scale = 100000000LL;
+			for(p++; p < eol && *p >= '0' && *p <= '9'; p++, scale /= 10)
+				time += (*p - '0') * scale;
+		}
+		if(!match(&p, eol, ":"))
+			continue;
+		while(p < eol && *p == ' ')
+			p++;
+
+		if(match(&p, eol, "tx id: "))
+			_f->type = LINE_TX;
+		else if(match(&p, eol, "rx id: "))
+			_f->type = LINE_RX;
+		else if(match(&p, eol, "ack id: "))
+			_f->type = LINE_ACK;
+		else
+			continue;
+		if(!parse_uint(&p, eol, &id) || !match(&p, eol, ", attempt: ") || !parse_uint(&p, eol, &v))
+			continue;
+		_f->attempt = (unsigned int)v;
+		// packets of session 0 carry no session
+		_f->session = 0;
+		if(match(&p, eol, ", session: ") && parse_uint(&p, eol, &v))
+			_f->session = (unsigned int)v;
+		if(_session >= 0 && _f->session != (unsigned int)_session)
+			continue;
+
+		_f->time = time;
+		_f->id = logfile_unwrap(_f, (unsigned int)id);
+		return 1;
+	}
+	return 0;
+}
+
+// write _v in decimal at _p; returns the end
+static char * put_uint(char * _p, unsigned long long _v)
+{
+	char digits[20];
+	int n = 0;
+	do {
+		digits[n++] = '0' + _v % 10;
+		_v /= 10;
+	} while(_v > 0);
+	while(n > 0)
+		*_p++ = digits[--n];
+	return _p;
+}
+
+// write _t [s] in milliseconds with three decimals at _p, as "%.3f"
+// would but without going through printf for every packet
+static char * put_ms(char * _p, float _t)
+{
+	long long us = (long long)(_t*1e6f + (_t < 0 ? -0.5f : 0.5f));
+	if(us < 0)
+	{
+		*_p++ = '-';
+		us = -us;
+	}
+	_p = put_uint(_p, us / 1000);
+	*_p++ = '.';
+	*_p++ = '0' + (us / 100) % 10;
+	*_p++ = '0' + (us / 10) % 10;
+	*_p++ = '0' + us % 10;
+	return _p;
+}
+
+// everything both logs say about one packet
+struct packet_s {
+	long long id;                       // unwrapped, -1 for an empty slot
+	long long tx[MAX_ATTEMPTS+1];       // bs time of each attempt, -1 if
+	                                    // not seen [ns]
+	unsigned int num_tx;                // transmissions seen
+	long long rx;                       // uav time of the first copy
+	                                    // received, -1 if none [ns]
+	unsigned int rx_attempt;            // its attempt, 0 if rebuilt
+	unsigned int rx_mask;               // bit a: attempt a was received
+	long long ack;                      // bs time of the ack, -1 if none
+	unsigned int ack_attempt;           // transmissions when acked
+};
+
+// a latency and its extremes [s]
+struct latency_s {
+	histogram_s h;
+	float min;
+	float max;
+};
+
+void latency_init(latency_s * _l)
+{
+	histogram_init(&_l->h, 1e-5f, 100.0f, 1);
+	_l->min = 0;
+	_l->max = 0;
+}
+
+void latency_add(latency_s * _l, float _t)
+{
+	if(histogram_count(&_l->h) == 0 || _t < _l->min)
+		_l->min = _t;
+	if(histogram_count(&_l->h) == 0 || _t > _l->max)
+		_l->max = _t;
+	histogram_add(&_l->h, _t);
+}
+
+void latency_print(const char * _name, const latency_s * _l)
+{
+	if(histogram_count(&_l->h) == 0)
+	{
+		printf("%-22s: none\n", _name);
+		return;
+	}
+	// percentiles are read at the upper edge of their bin, which may lie
+	// past the largest sample
+	float p[3] = { 0.5f, 0.9f, 0.99f };
+	unsigned int i;
+	for(i=0; i<3; i++)
+	{
+		p[i] = histogram_percentile(&_l->h, p[i]);
+		if(p[i] > _l->max)
+			p[i] = _l->max;
+	}
+	printf("%-22s: %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", _name, _l->min*1e3f,
+			p[0]*1e3f, p[1]*1e3f, p[2]*1e3f, _l->max*1e3f, histogram_mean(&_l->h)*1e3f);
+}
+
+struct correlator_s {
+	packet_s * window;                  // packets by id modulo capacity
+	unsigned int capacity;              // power of two
+	FILE * csv;
+
+	// uav clock minus bs clock [ns], fixed from the first window
+	long long offset;
+	bool offset_known;
+
+	unsigned long long packets;
+	unsigned long long delivered;
+	unsigned long long rebuilt;         // received only as rebuilt copies
+	unsigned long long transmissions;
+	unsigned long long lost;            // transmissions never received
+	unsigned long long late;            // lines for ids already out of the
+	                                    // window
+	unsigned long long attempts[MAX_ATTEMPTS+2];    // by attempt received,
+	                                                // the last for more
+
+	// runs of packets whose first transmission was lost, by length
+	unsigned long long bursts[MAX_BURST+2];
+	unsigned long long burst_packets;
+	unsigned int burst;                 // length of the current run
+	unsigned int longest_burst;
+	long long last_id;                  // last packet finalized
+
+	latency_s one_way;
+	latency_s delivery;
+	latency_s rtt;
+};
+
+// empty slot
+void packet_clear(packet_s * _p, long long _id)
+{
+	memset(_p, 0xff, sizeof(packet_s));
+	_p->id = _id;
+	_p->num_tx = 0;
+	_p->rx_attempt = 0;
+	_p->rx_mask = 0;
+	_p->ack_attempt = 0;
+}
+
+// the clock offset making the fastest transmission in the window take
+// no time
+void correlator_estimate_offset(correlator_s * _c)
+{
+	bool found = false;
+	unsigned int i;
+	unsigned int a;
+	for(i=0; i<_c->capacity; i++)
+	{
+		packet_s * p = &_c->window[i];
+		if(p->id < 0 || p->rx < 0)
+			continue;
+		// only the first copy's arrival time is kept
+		a = p->rx_attempt;
+		if(a < 1 || a > MAX_ATTEMPTS || p->tx[a] < 0)
+			continue;
+		if(!found || p->rx - p->tx[a] < _c->offset)
+			_c->offset = p->rx - p->tx[a];
+		found = true;
+	}
+	_c->offset_known = found;
+}
+
+// record a run of lost first transmissions that has ended
+void correlator_end_burst(correlator_s * _c)
+{
+	if(_c->burst == 0)
+		return;
+	_c->bursts[_c->burst <= MAX_BURST ? _c->burst : MAX_BURST+1]++;
+	_c->burst_packets += _c->burst;
+	if(_c->burst > _c->longest_burst)
+		_c->longest_burst = _c->burst;
+	_c->burst = 0;
+}
+
+// count a packet that has left the window
+void correlator_finalize(correlator_s * _c, packet_s * _p)
+{
+	if(_p->num_tx == 0 && _p->rx < 0)
+		return;
+	if(!_c->offset_known)
+		correlator_estimate_offset(_c);
+
+	_c->packets++;
+	_c->transmissions += _p->num_tx;
+	unsigned int a;
+	for(a=1; a<=MAX_ATTEMPTS; a++)
+	{
+		if(_p->tx[a] >= 0 && !(_p->rx_mask & (1u << a)))
+			_c->lost++;
+	}
+	if(_p->rx >= 0)
+	{
+		_c->delivered++;
+		if(_p->rx_attempt == 0)
+			_c->rebuilt++;
+		else
+			_c->attempts[_p->rx_attempt <= MAX_ATTEMPTS ? _p->rx_attempt : MAX_ATTEMPTS+1]++;
+	}
+
+	// bursts run over consecutive ids
+	if(_p->id != _c->last_id + 1)
+		correlator_end_burst(_c);
+	if(_p->tx[1] >= 0 && !(_p->rx_mask & 2u))
+		_c->burst++;
+	else
+		correlator_end_burst(_c);
+	_c->last_id = _p->id;
+
+	bool has_one_way = _p->rx >= 0 && _c->offset_known && _p->rx_attempt >= 1 &&
+	                   _p->rx_attempt <= MAX_ATTEMPTS && _p->tx[_p->rx_attempt] >= 0;
+	bool has_delivery = _p->rx >= 0 && _c->offset_known && _p->tx[1] >= 0;
+	// an ack after a resend may answer any copy, so only packets acked
+	// on their first transmission give round-trip times
+	bool has_rtt = _p->ack >= 0 && _p->ack_attempt == 1 && _p->tx[1] >= 0;
+	float one_way = has_one_way ? (_p->rx - _p->tx[_p->rx_attempt] - _c->offset) * 1e-9f : 0;
+	float delivery = has_delivery ? (_p->rx - _p->tx[1] - _c->offset) * 1e-9f : 0;
+	float rtt = has_rtt ? (_p->ack - _p->tx[1]) * 1e-9f : 0;
+	if(has_one_way)
+		latency_add(&_c->one_way, one_way);
+	if(has_delivery)
+		latency_add(&_c->delivery, delivery);
+	if(has_rtt)
+		latency_add(&_c->rtt, rtt);
+
+	if(_c->csv != NULL)
+	{
+		char line[128];
+		char * q = put_uint(line, _p->id);
+		*q++ = ',';
+		q = put_uint(q, _p->num_tx);
+		*q++ = ',';
+		if(_p->rx >= 0)
+			q = put_uint(q, _p->rx_attempt);
+		*q++ = ',';
+		if(has_one_way)
+			q = put_ms(q, one_way);
+		*q++ = ',';
+		if(has_delivery)
+			q = put_ms(q, delivery);
+		*q++ = ',';
+		if(has_rtt)
+			q = put_ms(q, rtt);
+		*q++ = '\n';
+		fwrite(line, 1, q - line, _c->csv);
+	}
+}
+
+// add the current line of _f
+void correlator_add(correlator_s * _c, const logfile_s * _f)
+{
+	packet_s * p = &_c->window[_f->id & (_c->capacity - 1)];
+	if(p->id != _f->id)
+	{
+		if(p->id > _f->id)
+		{
+			_c->late++;
+			return;
+		}
+		if(p->id >= 0)
+			correlator_finalize(_c, p);
+		packet_clear(p, _f->id);
+	}
+	switch(_f->type)
+	{
+		case LINE_TX:
+			p->num_tx++;
+			if(_f->attempt >= 1 && _f->attempt <= MAX_ATTEMPTS && p->tx[_f->attempt] < 0)
+				p->tx[_f->attempt] = _f->time;
+			break;
+		case LINE_RX:
+			if(p->rx < 0)
+			{
+				p->rx = _f->time;
+				p->rx_attempt = _f->attempt;
+			}
+			if(_f->attempt < 32)
+				p->rx_mask |= 1u << _f->attempt;
+			break;
+		case LINE_ACK:
+			if(p->ack < 0)
+			{
+				p->ack = _f->time;
+				p->ack_attempt = _f->attempt;
+			}
+			break;
+	}
+}
+
+int main (int argc, char **argv)
+{
+	int session = -1;
+	unsigned int window = 65536;
+	unsigned int id_bits = 16;
+	bool offset_given = false;
+	float offset = 0;
+	const char * csv_name = NULL;
+
+	int c;
+	static struct option long_options[] = {
+		{"session",		required_argument, 0, 'a'},
+		{"window",		required_argument, 0, 'b'},
+		{"id-bits",		required_argument, 0, 'c'},
+		{"offset",		required_argument, 0, 'd'},
+		{"csv",			required_argument, 0, 'e'},
+		{"help",		no_argument,       0, 'f'},
+		{0, 0, 0, 0},
+	};
+	int option_index = 0;
+	while (1)
+	{
+		c = getopt_long(argc, argv, "", long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c)
+		{
+			case 'a' :
+				session = atoi(optarg);
+				break;
+			case 'b' :
+				window = atoi(optarg);
+				break;
+			case 'c' :
+				id_bits = atoi(optarg);
+				break;
+			case 'd' :
+				offset = atof(optarg);
+				offset_given = true;
+				break;
+			case 'e' :
+				csv_name = optarg;
+				break;
+			case 'f' :
+			default :
+				usage();
+		}
+	}
+	if(argc - optind != 2)
+		usage();
+	if(id_bits != 16 && id_bits != 32)
+	{
+		fprintf(stderr,"error: %s, id bits must be 16 or 32\n", argv[0]);
+		exit(1);
+	}
+	if(window == 0 || window > (1u << 26))
+	{
+		fprintf(stderr,"error: %s, window must be in [1,%u]\n", argv[0], 1u << 26);
+		exit(1);
+	}
+
+	logfile_s bs;
+	logfile_s uav;
+	logfile_open(&bs, argv[optind], id_bits);
+	logfile_open(&uav, argv[optind+1], id_bits);
+
+	correlator_s cr;
+	memset(&cr, 0x00, sizeof(cr));
+	cr.capacity = 1;
+	while(cr.capacity < window)
+		cr.capacity <<= 1;
+	cr.window = (packet_s*) malloc(cr.capacity*sizeof(packet_s));
+	unsigned int i;
+	for(i=0; i<cr.capacity; i++)
+		packet_clear(&cr.window[i], -1);
+	cr.offset = (long long)(offset * 1e9);
+	cr.offset_known = offset_given;
+	cr.last_id = -2;
+	latency_init(&cr.one_way);
+	latency_init(&cr.delivery);
+	latency_init(&cr.rtt);
+	cr.csv = NULL;
+	if(csv_name != NULL)
+	{
+		cr.csv = fopen(csv_name, "w");
+		if(cr.csv == NULL)
+		{
+			fprintf(stderr,"error: %s, could not open '%s'\n", argv[0], csv_name);
+			exit(1);
+		}
+		setvbuf(cr.csv, NULL, _IOFBF, 1 << 20);
+		fprintf(cr.csv, "id,transmissions,rx_attempt,one_way_ms,delivery_ms,rtt_ms\n");
+	}
+
+	// the uav log names its session; take the base station's packets of
+	// that one
+	int have_uav = logfile_next(&uav, session);
+	if(session < 0)
+		session = have_uav ? (int)uav.session : 0;
+	int have_bs = logfile_next(&bs, session);
+
+	// walk both logs in step by id, base station first on a tie, so
+	// each packet's lines meet inside the window
+	while(have_bs || have_uav)
+	{
+		if(have_bs && (!have_uav || bs.id <= uav.id))
+		{
+			correlator_add(&cr, &bs);
+			have_bs = logfile_next(&bs, session);
+		}
+		else
+		{
+			correlator_add(&cr, &uav);
+			have_uav = logfile_next(&uav, session);
+		}
+	}
+
+	// then whatever is still in the window, in id order
+	long long top = bs.max_id > uav.max_id ? bs.max_id : uav.max_id;
+	long long id;
+	for(id = top - cr.capacity + 1; id <= top; id++)
+	{
+		packet_s * p = &cr.window[id & (cr.capacity - 1)];
+		if(id >= 0 && p->id == id)
+			correlator_finalize(&cr, p);
+	}
+	correlator_end_burst(&cr);
+
+	printf("session %d: %llu packets, %llu delivered (%.2f%%), %llu never received\n", session,
+			cr.packets, cr.delivered, cr.packets > 0 ? 100.0*cr.delivered/cr.packets : 0.0,
+			cr.packets - cr.delivered);
+	printf("transmissions: %llu, %llu lost (%.2f%%)\n", cr.transmissions, cr.lost,
+			cr.transmissions > 0 ? 100.0*cr.lost/cr.transmissions : 0.0);
+	if(cr.late > 0)
+		printf("warning: %llu lines were for packets already out of the window (see --window)\n", cr.late);
+	if(!cr.offset_known)
+		printf("no transmission matched to its reception: one-way latencies unknown\n");
+	else if(!offset_given)
+		printf("clock offset: %.6f s (one-way latency of the fastest packet taken as 0)\n", cr.offset*1e-9);
+
+	printf("\n%-22s  %9s %9s %9s %9s %9s %9s\n", "latency [ms]", "min", "p50", "p90", "p99", "max", "mean");
+	latency_print("one-way", &cr.one_way);
+	latency_print("from first tx", &cr.delivery);
+	latency_print("ack round trip", &cr.rtt);
+
+	printf("\nattempts to success:\n");
+	unsigned int a;
+	for(a=1; a<=MAX_ATTEMPTS+1; a++)
+	{
+		if(cr.attempts[a] == 0)
+			continue;
+		printf("  %2u%s: %10llu (%6.2f%%)\n", a, a > MAX_ATTEMPTS ? "+" : " ",
+				cr.attempts[a], 100.0*cr.attempts[a]/cr.delivered);
+	}
+	if(cr.rebuilt > 0)
+		printf("  rebuilt: %7llu (%6.2f%%)\n", cr.rebuilt, 100.0*cr.rebuilt/cr.delivered);
+
+	unsigned long long num_bursts = 0;
+	for(a=1; a<=MAX_BURST+1; a++)
+		num_bursts += cr.bursts[a];
+	printf("\nbursts of lost first transmissions: %llu", num_bursts);
+	if(num_bursts > 0)
+		printf(", mean length %.2f, longest %u", (double)cr.burst_packets/num_bursts, cr.longest_burst);
+	printf("\n");
+	for(a=1; a<=MAX_BURST+1; a++)
+	{
+		if(cr.bursts[a] > 0)
+			printf("  %2u%s: %10llu\n", a, a > MAX_BURST ? "+" : " ", cr.bursts[a]);
+	}
+
+	if(cr.csv != NULL)
+		fclose(cr.csv);
+	free(cr.window);
+	logfile_close(&bs);
+	logfile_close(&uav);
+	return 0;
+}
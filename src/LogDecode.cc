@@ -0,0 +1,111 @@
+//
+// LogDecode
+//
+// Convert a binary event log written by BaseStation or UAV back into
+// the text format of the bs-*.log / uav-*.log files.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "evlog.h"
+
+// number of records read per fread
+#define RECORDS_PER_READ 4096
+
+void usage() {
+	printf("Usage: LogDecode <input.evlog> [output.log]\n");
+	printf("  Writes to stdout if no output file is given.\n");
+	exit(0);
+}
+
+int main (int argc, char **argv)
+{
+	if(argc < 2 || argc > 3 || strcmp(argv[1], "--help") == 0)
+		usage();
+
+	FILE * fin = fopen(argv[1], "rb");
+	if(fin == NULL)
+	{
+		fprintf(stderr,"error: %s, could not open '%s'\n", argv[0], argv[1]);
+		exit(1);
+	}
+	FILE * fout = stdout;
+	if(argc == 3)
+	{
+		fout = fopen(argv[2], "w");
+		if(fout == NULL)
+		{
+			fprintf(stderr,"error: %s, could not open '%s'\n", argv[0], argv[2]);
+			exit(1);
+		}
+	}
+
+	evlog_header_s header;
+	if(fread(&header, sizeof(header), 1, fin) != 1 ||
+	   memcmp(header.magic, EVLOG_MAGIC, 8) != 0 ||
+	   header.record_len != sizeof(evlog_record_s))
+	{
+		fprintf(stderr,"error: %s, '%s' is not an event log\n", argv[0], argv[1]);
+		exit(1);
+	}
+	bool bs = header.source == EVLOG_SOURCE_BASESTATION;
+
+	evlog_record_s * records = (evlog_record_s*) malloc(RECORDS_PER_READ*sizeof(evlog_record_s));
+	size_t n;
+	size_t i;
+	while((n = fread(records, sizeof(evlog_record_s), RECORDS_PER_READ, fin)) > 0)
+	{
+		for(i=0; i<n; i++)
+		{
+			evlog_record_s * r = &records[i];
+
+			// base station stamps wall-clock time (offset by 1e7 s),
+			// the uav time since it started
+			long long dt = r->timestamp - header.start_clock;
+			if(bs)
+			{
+				long long ns = header.start_time + dt - 10000000LL*1000000000LL;
+				fprintf(fout, "%lld.%06lld:", ns / 1000000000LL, (ns % 1000000000LL) / 1000);
+			}
+			else
+			{
+				fprintf(fout, "%.6f: ", dt*1e-9);
+			}
+
+			switch(r->type)
+			{
+				case EVLOG_START:
+					fprintf(fout, bs ? "base station started\n" : "uav started\n");
+					break;
+				case EVLOG_DONE:
+					fprintf(fout, bs ? "Base station done\n" : "uav done\n");
+					break;
+				case EVLOG_TX:
+					fprintf(fout, "tx id: %u, attempt: %u", r->id, r->attempt);
+					break;
+				case EVLOG_RX:
+					fprintf(fout, "rx id: %u, attempt: %u", r->id, r->attempt);
+					break;
+				case EVLOG_ACK:
+					fprintf(fout, "ack id: %u, attempt: %u", r->id, r->attempt);
+					break;
+				default:
+					fprintf(fout, "unknown event %u\n", r->type);
+			}
+			// packets of a single-uav link keep the original format
+			if(r->type == EVLOG_TX || r->type == EVLOG_RX || r->type == EVLOG_ACK)
+			{
+				if(r->session != 0)
+					fprintf(fout, ", session: %u", r->session);
+				fprintf(fout, "\n");
+			}
+		}
+	}
+
+	free(records);
+	fclose(fin);
+	if(fout != stdout)
+		fclose(fout);
+	return 0;
+}
@@ -6,116 +6,19 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 #include <assert.h>
 #include <liquid/liquid.h>
 
 #include <uhd/usrp/multi_usrp.hpp>
 
-#include <liquid/ofdmtxrx.h>
 #include "timer.h"
-
-#define lock(s) pthread_mutex_lock(s)
-#define unlock(s) pthread_mutex_unlock(s)
-
-static bool verbose;
-
-std::list<unsigned int> acks_to_send;
-std::list<unsigned int> nacks_to_send;
-
-pthread_mutex_t acks_to_send_mutex;
-pthread_mutex_t nacks_to_send_mutex;
-
-timer program_timer = timer_create();
-std::string log_string="";
-
-void log(std::string msg)
-{
-	float f = timer_toc(program_timer);
-	std::ostringstream os;
-	os << f << ": " << msg << std::endl;
-	log_string += os.str();
-}
-
-unsigned char fb_header[8];
-unsigned char fb_payload[1];
-
-timer rx_timer;
-timer packet_arrival_timer;
-bool first_packet_arrived = false;
-float total_elapsed_time;
-// data counters
-unsigned int num_frames_detected;
-unsigned int num_valid_headers_received;
-unsigned int num_valid_packets_received;
-unsigned int num_valid_bytes_received;
-
-// callback function
-int callback(unsigned char *  _header,
-		int              _header_valid,
-		unsigned char *  _payload,
-		unsigned int     _payload_len,
-		int              _payload_valid,
-		framesyncstats_s _stats,
-		void *           _userdata)
-{
-
-	if (_header_valid) 
-	{
-		unsigned int packet_id = (_header[0] << 8 | _header[1]);
-		unsigned int attempt_num = _header[2];
-		//simulate missing 10% of packets entirely to trigger timeouts on tx side
-		bool missed = 0; //rand() % 10 == 3 ? true : false;
-		if(missed)
-			std::cout << "missed packet " << packet_id << std::endl;
-		else
-		{
-			timer_tic(packet_arrival_timer);
-			if(!first_packet_arrived)
-			{
-				timer_tic(rx_timer);
-				first_packet_arrived = true;
-			}
-			else
-			{
-				total_elapsed_time = timer_toc(rx_timer);
-			}
-
-			num_valid_headers_received++;
-			//simulate 10% bad payloads to make sure we send some nacks
-			bool still_valid = 1;//rand() % 10 != 3 ? true : false;
-			if (_payload_valid && still_valid) 
-			{
-				lock(&acks_to_send_mutex);
-				acks_to_send.push_back(packet_id);
-				unlock(&acks_to_send_mutex);
-				if(verbose)printf("rx packet id: %6u, attempt: %u", packet_id, attempt_num);
-				std::ostringstream msg;
-				msg << "rx id: " << packet_id << ", attempt: " << attempt_num;
-				log(msg.str());
-				num_valid_packets_received++;
-				num_valid_bytes_received += _payload_len;
-				if(verbose)printf(" VALID\n");
-			}
-			else
-			{
-				if(verbose)printf("rx packet id: %6u", packet_id);
-				lock(&nacks_to_send_mutex);
-				nacks_to_send.push_back(packet_id);
-				unlock(&nacks_to_send_mutex);
-				printf(" PAYLOAD INVALID\n");
-			}
-		}
-	} 
-	else 
-	{
-		printf("HEADER INVALID\n");
-	}
-	// update global counters
-	num_frames_detected++;
-
-	return 0;
-}
+#include "evlog.h"
+#include "usrp_transceiver.h"
+#include "txpipeline.h"
+#include "uavnode.h"
+#include "linkstats.h"
 
 void usage() {
 	printf("Transmission options:\n");
@@ -151,17 +54,53 @@ void usage() {
 	printf("Miscellaneous options:\n");
 	printf("  --rx-timeout          Set the time to wait to quit after not receiving any packets\n");
 	printf("                                [Default: 3.0 seconds]\n");
+	printf("  --output              Write the received data, in order and without duplicates, to this\n");
+	printf("                        file or named pipe\n");
+	printf("                                [Default: none]\n");
+	printf("  --reorder-window      Set the number of packets held waiting for an earlier one\n");
+	printf("                                [Default: 4096]\n");
+	printf("  --erasure-window      Keep the last N packets to rebuild lost ones from the base\n");
+	printf("                        station's erasure repair frames, instead of nacking them\n");
+	printf("                                [Default: 0 (off)]\n");
+	printf("  --harq-buffers        Keep up to N failed packets and soft-combine their retransmissions\n");
+	printf("                                [Default: 0 (off)]\n");
+	printf("  --session             Set the session id the base station gave this UAV\n");
+	printf("                                [Default: 0]\n");
+	printf("  --tx-queue            Set the number of acks queued for the transmit thread\n");
+	printf("                        (0: transmit from the main loop)\n");
+	printf("                                [Default: 2]\n");
+	printf("  --stats-name          Publish live link stats in this shared-memory segment for\n");
+	printf("                        uavstat (none: do not publish)\n");
+	printf("                                [Default: %s]\n", LINKSTATS_NAME_UAV);
+	printf("  --tsc-clock           Read timestamps from the CPU timestamp counter\n");
+	printf("                                [Default: false]\n");
 	printf("  --verbose             Enable extra output\n");
 	printf("                                [Default: false]\n");
 	printf("  --help                Display this help message\n");
 	exit(0);
 }
 
+// snapshot of the uav's counters for uavstat
+void fill_stats(linkstats_page_s * _page, void * _userdata)
+{
+	uavnode uav = (uavnode) _userdata;
+	uavnode_stats_s s;
+	uavnode_get_stats(uav, &s);
+	_page->frames_sent = s.num_acks_sent;
+	_page->frames_detected = s.num_frames_detected;
+	_page->packets_delivered = s.num_valid_packets_received;
+	_page->bytes_delivered = s.num_unique_bytes_received;
+	_page->harq_recovered = s.num_harq_recovered;
+	_page->messages = s.num_messages_received;
+	uavnode_get_link_quality(uav, &_page->evm, &_page->rssi);
+}
+
 int main (int argc, char **argv)
 {
-	timer_tic(program_timer);
 	// command-line options
-	verbose = false;
+	uavnode_props_s props;
+	uavnode_props_init_default(&props);
+	bool tsc_clock = false;
 
 	float frequency = 462e6;
 	float bandwidth = 500e3f;
@@ -175,15 +114,12 @@ int main (int argc, char **argv)
 	unsigned int taper_len = 4;         // taper length
 
 	int debug_enabled =  0;             // enable debugging?
+	unsigned int tx_queue = 2;          // frames queued for the tx thread
+	const char * stats_name = LINKSTATS_NAME_UAV;
 
 	modulation_scheme ms = LIQUID_MODEM_QPSK;// modulation scheme
-	unsigned int payload_len = 1024;        // original data message length
 	fec_scheme fec0 = LIQUID_FEC_CONV_V29P23; // fec (outer)
 	fec_scheme fec1 = LIQUID_FEC_RS_M8;      // fec (inner)
-	rx_timer = timer_create();
-
-	float rx_timeout = 3.0;
-	packet_arrival_timer = timer_create();
 
 
 	float rx_frequency = frequency;
@@ -206,6 +142,14 @@ int main (int argc, char **argv)
 		{"rx-timeout",	        required_argument, 0, 'l'},
 		{"help",                no_argument,       0, 'm'},
 		{"verbose",           no_argument, 0, 'n'},
+		{"tsc-clock",         no_argument, 0, 'o'},
+		{"session",           required_argument, 0, 'p'},
+		{"harq-buffers",      required_argument, 0, 'q'},
+		{"tx-queue",          required_argument, 0, 'r'},
+		{"stats-name",        required_argument, 0, 's'},
+		{"output",            required_argument, 0, 't'},
+		{"reorder-window",    required_argument, 0, 'u'},
+		{"erasure-window",    required_argument, 0, 'v'},
 	};
 	int option_index = 0;
 
@@ -268,135 +212,113 @@ int main (int argc, char **argv)
 				}
 				break;
 			case 'l' :
-				rx_timeout = atof(optarg);
+				props.rx_timeout = atof(optarg);
 				break;
 			case 'm' :
 				usage();
 				break;
 			case 'n' :
-				verbose = true;
+				props.verbose = true;
+				break;
+			case 'o' :
+				tsc_clock = true;
+				break;
+			case 'p' :
+				props.session = atoi(optarg);
+				break;
+			case 'q' :
+				props.harq_buffers = atoi(optarg);
+				break;
+			case 'r' :
+				tx_queue = atoi(optarg);
+				break;
+			case 's' :
+				stats_name = optarg;
+				break;
+			case 't' :
+				props.output = optarg;
+				break;
+			case 'u' :
+				props.reorder_window = atoi(optarg);
+				break;
+			case 'v' :
+				props.erasure_window = atoi(optarg);
 				break;
 
 		}
 
 	}
 
+	// switch clocks before the event log starts its writer thread
+	if(tsc_clock && !timer_enable_tsc())
+		std::cout << "TSC clock not available. Using CLOCK_MONOTONIC." << std::endl;
+	std::ostringstream filename;
+	time_t t = time(0);
+	struct tm * now = localtime(&t);
+	filename << "uav-" << now->tm_mon + 1 << ":" << now->tm_mday << ":" << now->tm_hour << ":" << now->tm_min << ".evlog";
+	evlog event_log = evlog_create(filename.str().c_str(), EVLOG_SOURCE_UAV);
+
 	std::cout << "tx freq: " << tx_frequency << std::endl;
 	std::cout << "rx freq: " << rx_frequency << std::endl;
 
 	if (cp_len == 0 || cp_len > M) {
 		fprintf(stderr,"error: %s, cyclic prefix must be in (0,M]\n", argv[0]);
 		exit(1);
+	} else if (props.session >= SESSION_MAX) {
+		fprintf(stderr,"error: %s, session must be in [0,%u)\n", argv[0], SESSION_MAX);
+		exit(1);
+	} else if (props.reorder_window == 0 || props.reorder_window > 32768) {
+		fprintf(stderr,"error: %s, reorder window must be in [1,32768]\n", argv[0]);
+		exit(1);
+	} else if (props.erasure_window > 32768) {
+		fprintf(stderr,"error: %s, erasure window must be in [0,32768]\n", argv[0]);
+		exit(1);
 	}
 
+	uavnode uav = uavnode_create(&props, event_log);
+
+	// publish counters while the link runs
+	linkstats stats = strcmp(stats_name, "none") != 0 ?
+		linkstats_create(stats_name, LINKSTATS_SOURCE_UAV, 0.5f, fill_stats, (void*)uav) : NULL;
+
 	// create transceiver object
 	unsigned char * p = NULL;   // default subcarrier allocation
-	ofdmtxrx txcvr(M, cp_len, taper_len, p, callback,(void*)&txcvr);
+	usrp_transceiver radio(M, cp_len, taper_len, p, uavnode_callback, (void*)uav);
+
+	// encode and send acks on their own thread unless disabled
+	pipelined_transceiver * pipeline = tx_queue > 0 ? new pipelined_transceiver(&radio, tx_queue, 0) : NULL;
+	transceiver * txcvr = pipeline != NULL ? (transceiver*)pipeline : (transceiver*)&radio;
 
 	// set properties
-	txcvr.set_rx_freq(rx_frequency);
-	txcvr.set_rx_rate(bandwidth);
-	txcvr.set_rx_gain_uhd(uhd_rxgain);
+	txcvr->set_rx_freq(rx_frequency);
+	txcvr->set_rx_rate(bandwidth);
+	txcvr->set_rx_gain_uhd(uhd_rxgain);
 
-	txcvr.set_tx_freq(tx_frequency);
-	txcvr.set_tx_rate(bandwidth);
-	txcvr.set_tx_gain_soft(txgain_dB);
-	txcvr.set_tx_gain_uhd(uhd_txgain);
+	txcvr->set_tx_freq(tx_frequency);
+	txcvr->set_tx_rate(bandwidth);
+	txcvr->set_tx_gain_soft(txgain_dB);
+	txcvr->set_tx_gain_uhd(uhd_txgain);
 
 	// enable debugging on request
 	if (debug_enabled)
-		txcvr.debug_enable();
-
-	// reset counters
-	num_frames_detected=0;
-	num_valid_headers_received=0;
-	num_valid_packets_received=0;
-	num_valid_bytes_received=0;
-
-	unsigned char header[8];
-	unsigned char payload[payload_len];
-	for(unsigned int lcv = 0; lcv < payload_len; lcv++)
-	{
-		payload[lcv] = rand() & 0xff;
-	}
-
-
-	// run conditions
-	int continue_running = 1;
-	timer t0 = timer_create();
-	timer_tic(t0);
+		txcvr->debug_enable();
 
 	// start receiver
-	txcvr.start_rx();
+	txcvr->start_rx();
 	std::cout << "UAV awaiting data from Basestation." << std::endl;
-	while (continue_running) {
-		lock(&acks_to_send_mutex);
-		while(acks_to_send.size() > 0)
-		{
-			header[0] = (acks_to_send.front() >> 8) & 0xff;
-			header[1] = (acks_to_send.front()     ) & 0xff;
-			header[2] = 0;
-			//std::cout << "transmitting ack for " << acks_to_send.front() << std::endl;
-			txcvr.transmit_packet(header, payload, payload_len, LIQUID_MODEM_BPSK, LIQUID_FEC_CONV_V29P23, LIQUID_FEC_RS_M8);
-			acks_to_send.pop_front();
-		}
-		unlock(&acks_to_send_mutex);
-
-		lock(&nacks_to_send_mutex);
-		while(nacks_to_send.size() > 0)
-		{
-			header[0] = (nacks_to_send.front() >> 8) & 0xff;
-			header[1] = (nacks_to_send.front()     ) & 0xff;
-			header[2] = 1;
-			//std::cout << "transmitting nack for " << nacks_to_send.front() << std::endl;
-			txcvr.transmit_packet(header, payload, payload_len, LIQUID_MODEM_BPSK, LIQUID_FEC_CONV_V29P23, LIQUID_FEC_RS_M8);
-			nacks_to_send.pop_front();
-		}
-		unlock(&nacks_to_send_mutex);
-		// sleep for 100 ms and check state
-		usleep(100000);
-		if(first_packet_arrived && timer_toc(packet_arrival_timer) > rx_timeout)
-		{
-			std::cout << "no packets received for " << rx_timeout << " seconds, quitting." << std::endl;
-			continue_running = 0;
-		}
-	}
+	uavnode_run(uav, txcvr);
+	delete pipeline;
 
 	// stop receiver
 	printf("ofdmflexframe_rx stopping receiver...\n");
-	txcvr.stop_rx();
+	radio.stop_rx();
 
-	// compute actual run-time
-	//float runtime = timer_toc(t0);
-	//compute runtime = time of last packet arrival - time of first packet arrival
-	float runtime = total_elapsed_time;
 	// print results
-	float data_rate = num_valid_bytes_received * 8.0f / runtime;
-	float percent_headers_valid = (num_frames_detected == 0) ?
-		0.0f :
-		100.0f * (float)num_valid_headers_received / (float)num_frames_detected;
-	float percent_packets_valid = (num_frames_detected == 0) ?
-		0.0f :
-		100.0f * (float)num_valid_packets_received / (float)num_frames_detected;
-	printf("    frames detected     : %6u\n", num_frames_detected);
-	printf("    valid headers       : %6u (%6.2f%%)\n", num_valid_headers_received,percent_headers_valid);
-	printf("    valid packets       : %6u (%6.2f%%)\n", num_valid_packets_received,percent_packets_valid);
-	printf("    bytes received      : %6u\n", num_valid_bytes_received);
-	printf("    run time            : %f s\n", runtime);
-	printf("    data rate           : %8.4f kbps\n", data_rate*1e-3f);
+	linkstats_destroy(stats);
+	uavnode_print_stats(uav);
 
-	std::ostringstream filename;
-	time_t t = time(0);
-	struct tm * now = localtime(&t);
-	filename << "uav-" << now->tm_mon + 1 << ":" << now->tm_mday << ":" << now->tm_hour << ":" << now->tm_min << ".log";
-	std::ofstream log_file;
-	log_file.open(filename.str().c_str());
-	log_file << log_string << std::endl;
-	log_file.close();
-	
 	// destroy objects
-	timer_destroy(t0);
-	timer_destroy(program_timer);
+	evlog_destroy(event_log);
+	uavnode_destroy(uav);
 	return 0;
 }
-
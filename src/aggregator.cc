@@ -0,0 +1,123 @@
+//
+// aggregator
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "timer.h"
+#include "aggregator.h"
+
+struct aggregator_s {
+    unsigned char * buffer;
+    unsigned int max_len;
+    unsigned int len;           // bytes used
+    unsigned int size;          // messages in the frame
+    int full;
+    long long delay;            // latency budget [ns]
+    long long deadline;         // when the frame is due [ns]
+};
+
+// create aggregator
+aggregator aggregator_create(unsigned int _max_len, float _delay)
+{
+    aggregator q = (aggregator) malloc(sizeof(struct aggregator_s));
+    q->buffer   = (unsigned char*) malloc(_max_len);
+    q->max_len  = _max_len;
+    q->len      = 0;
+    q->size     = 0;
+    q->full     = 0;
+    q->delay    = (long long)(_delay * 1e9);
+    q->deadline = 0;
+    return q;
+}
+
+// destroy aggregator
+void aggregator_destroy(aggregator _q)
+{
+    free(_q->buffer);
+    free(_q);
+}
+
+// append message
+int aggregator_push(aggregator            _q,
+                    const unsigned char * _msg,
+                    unsigned int          _msg_len)
+{
+    if (_msg_len > 0xffff || _q->len + AGGREGATOR_PREFIX_LEN + _msg_len > _q->max_len) {
+        // nothing more can join this frame
+        if (_q->size > 0)
+            _q->full = 1;
+        return 0;
+    }
+
+    if (_q->size == 0)
+        _q->deadline = timer_now_ns() + _q->delay;
+
+    _q->buffer[_q->len++] = (_msg_len >> 8) & 0xff;
+    _q->buffer[_q->len++] = (_msg_len     ) & 0xff;
+    memcpy(&_q->buffer[_q->len], _msg, _msg_len);
+    _q->len += _msg_len;
+    _q->size++;
+
+    // not even an empty message would fit after this one
+    if (_q->len + AGGREGATOR_PREFIX_LEN > _q->max_len)
+        _q->full = 1;
+    return 1;
+}
+
+// number of messages waiting
+unsigned int aggregator_size(aggregator _q)
+{
+    return _q->size;
+}
+
+// seconds until the frame is due
+float aggregator_next_timeout(aggregator _q)
+{
+    if (_q->size == 0)
+        return -1.0f;
+    if (_q->full)
+        return 0.0f;
+    long long dt = _q->deadline - timer_now_ns();
+    return dt > 0 ? dt*1e-9f : 0.0f;
+}
+
+// mark the frame full
+void aggregator_close(aggregator _q)
+{
+    if (_q->size > 0)
+        _q->full = 1;
+}
+
+// copy the frame out and start a new one
+unsigned int aggregator_flush(aggregator _q, unsigned char * _payload)
+{
+    unsigned int len = _q->len;
+    memcpy(_payload, _q->buffer, len);
+    _q->len  = 0;
+    _q->size = 0;
+    _q->full = 0;
+    return len;
+}
+
+// step through the messages of a received payload
+int aggregator_next(const unsigned char *  _payload,
+                    unsigned int           _payload_len,
+                    unsigned int *         _offset,
+                    const unsigned char ** _msg,
+                    unsigned int *         _msg_len)
+{
+    unsigned int i = *_offset;
+    if (i + AGGREGATOR_PREFIX_LEN > _payload_len)
+        return 0;
+
+    unsigned int n = (_payload[i] << 8) | _payload[i+1];
+    i += AGGREGATOR_PREFIX_LEN;
+    if (n > _payload_len - i)
+        return 0;
+
+    *_msg     = &_payload[i];
+    *_msg_len = n;
+    *_offset  = i + n;
+    return 1;
+}
@@ -0,0 +1,54 @@
+//
+// aggregator
+//
+// Packs small application messages into one frame payload, so that a
+// burst of telemetry or commands shares a single preamble, header and
+// FEC tail instead of padding each message out to a full frame. Each
+// message is written as a 2-byte big-endian length followed by its
+// bytes, and the frame is marked with FRAMEHEADER_FLAG_AGGREGATED. A
+// frame is handed out once the next message would not fit or the
+// oldest message has waited for the latency budget.
+//
+
+#ifndef __AGGREGATOR_H__
+#define __AGGREGATOR_H__
+
+// bytes of framing added to each message
+#define AGGREGATOR_PREFIX_LEN 2
+
+typedef struct aggregator_s * aggregator;
+
+// create aggregator building payloads of up to _max_len bytes; a
+// message waits at most _delay seconds for others to join it
+aggregator aggregator_create(unsigned int _max_len, float _delay);
+
+// destroy aggregator
+void aggregator_destroy(aggregator _q);
+
+// append message; returns 0 if it does not fit in the current frame
+int aggregator_push(aggregator            _q,
+                    const unsigned char * _msg,
+                    unsigned int          _msg_len);
+
+// number of messages waiting
+unsigned int aggregator_size(aggregator _q);
+
+// seconds until the frame is due: 0 if it is full or its oldest
+// message has used up the latency budget, -1 if it is empty
+float aggregator_next_timeout(aggregator _q);
+
+// mark the frame full so it is sent without waiting further
+void aggregator_close(aggregator _q);
+
+// copy the frame to _payload and start a new one; returns its length
+unsigned int aggregator_flush(aggregator _q, unsigned char * _payload);
+
+// step through the messages of a received payload; *_offset starts at
+// 0. Returns 0 once no complete message is left.
+int aggregator_next(const unsigned char *  _payload,
+                    unsigned int           _payload_len,
+                    unsigned int *         _offset,
+                    const unsigned char ** _msg,
+                    unsigned int *         _msg_len);
+
+#endif // __AGGREGATOR_H__
@@ -0,0 +1,118 @@
+//
+// blockack
+//
+
+#include <string.h>
+#include <math.h>
+#include "blockack.h"
+
+// clear block ack and set its base packet id
+void blockack_init(blockack_s * _q, unsigned int _base_id)
+{
+    _q->base_id = _base_id;
+    _q->span = 0;
+    memset(_q->acked,  0x00, BLOCKACK_BITMAP_LEN);
+    memset(_q->nacked, 0x00, BLOCKACK_BITMAP_LEN);
+    _q->evm  = 0.0f;
+    _q->rssi = 0.0f;
+}
+
+// set link quality reported with the block ack
+void blockack_set_link_quality(blockack_s * _q, float _evm, float _rssi)
+{
+    _q->evm  = _evm;
+    _q->rssi = _rssi;
+}
+
+// mark packet as received (_ack=1) or failed (_ack=0)
+int blockack_add(blockack_s * _q, unsigned int _id, int _ack)
+{
+    // offset from base; ids before the base do not fit either
+    int i = frameheader_seq_diff(_id, _q->base_id);
+    if (i < 0 || i >= BLOCKACK_MAX_SPAN)
+        return 0;
+
+    unsigned char mask = 1 << (i & 7);
+    if (_ack) {
+        // a good copy overrides any earlier failure
+        _q->acked[i>>3]  |=  mask;
+        _q->nacked[i>>3] &= ~mask;
+    } else if (!(_q->acked[i>>3] & mask)) {
+        _q->nacked[i>>3] |=  mask;
+    }
+
+    if ((unsigned int)i + 1 > _q->span)
+        _q->span = i + 1;
+    return 1;
+}
+
+// is the block ack empty?
+int blockack_empty(blockack_s * _q)
+{
+    return _q->span == 0;
+}
+
+// write frame header and payload; returns the payload length
+//  header       : FRAMEHEADER_TYPE_BLOCKACK, seq = base id, info = n
+//  payload[0]   : -EVM in quarter dB, saturating at 0 and -63.75 dB
+//  payload[1]   : RSSI in dB as a signed byte
+//  payload[2..] : n bytes of ack bitmap followed by n bytes of nack bitmap
+unsigned int blockack_encode(blockack_s *   _q,
+                             unsigned int    _session,
+                             unsigned char * _header,
+                             unsigned char * _payload)
+{
+    unsigned int n = (_q->span + 7) / 8;
+    if (n == 0)
+        n = 1;
+
+    frameheader_s h;
+    h.seq     = _q->base_id;
+    h.type    = FRAMEHEADER_TYPE_BLOCKACK;
+    h.session = _session;
+    h.flags   = 0;
+    h.info    = n;
+    frameheader_encode(&h, _header);
+
+    long evm  = lrintf(-4.0f*_q->evm);
+    long rssi = lrintf(_q->rssi);
+    _payload[0] = evm  <    0 ? 0    : evm  > 255 ? 255 : evm;
+    _payload[1] = rssi < -128 ? -128 : rssi > 127 ? 127 : rssi;
+
+    memcpy(&_payload[BLOCKACK_QUALITY_LEN],     _q->acked,  n);
+    memcpy(&_payload[BLOCKACK_QUALITY_LEN + n], _q->nacked, n);
+    return BLOCKACK_QUALITY_LEN + 2*n;
+}
+
+// parse received frame; returns 0 if it is not a valid block ack
+int blockack_decode(blockack_s *          _q,
+                    const frameheader_s * _header,
+                    unsigned char *       _payload,
+                    unsigned int          _payload_len)
+{
+    unsigned int n = _header->info;
+    if (_header->type != FRAMEHEADER_TYPE_BLOCKACK || n == 0 ||
+        n > BLOCKACK_BITMAP_LEN || _payload_len < BLOCKACK_QUALITY_LEN + 2*n)
+    {
+        return 0;
+    }
+
+    blockack_init(_q, _header->seq);
+    memcpy(_q->acked,  &_payload[BLOCKACK_QUALITY_LEN],     n);
+    memcpy(_q->nacked, &_payload[BLOCKACK_QUALITY_LEN + n], n);
+    _q->span = 8*n;
+    _q->evm  = -0.25f*_payload[0];
+    _q->rssi = (signed char)_payload[1];
+    return 1;
+}
+
+// get status of the i-th id covered by the block ack
+int blockack_is_acked(blockack_s * _q, unsigned int _i)
+{
+    return _i < _q->span && (_q->acked[_i>>3] >> (_i & 7)) & 1;
+}
+
+int blockack_is_nacked(blockack_s * _q, unsigned int _i)
+{
+    return _i < _q->span && (_q->nacked[_i>>3] >> (_i & 7)) & 1;
+}
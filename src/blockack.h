@@ -0,0 +1,67 @@
+//
+// blockack
+//
+// Compact acknowledgement frame sent by the UAV: a base sequence plus
+// one bitmap of received packets and one of packets whose payload
+// failed, so a single short frame answers for many data frames. It
+// also reports how well the UAV is hearing the base station, for rate
+// adaptation.
+//
+
+#ifndef __BLOCKACK_H__
+#define __BLOCKACK_H__
+
+#include "frameheader.h"
+
+// maximum number of packet ids covered by one block ack
+#define BLOCKACK_MAX_SPAN 256
+
+// bytes per bitmap
+#define BLOCKACK_BITMAP_LEN (BLOCKACK_MAX_SPAN/8)
+
+// bytes of link quality ahead of the bitmaps
+#define BLOCKACK_QUALITY_LEN 2
+
+// maximum payload length of an encoded block ack
+#define BLOCKACK_MAX_PAYLOAD_LEN (BLOCKACK_QUALITY_LEN + 2*BLOCKACK_BITMAP_LEN)
+
+struct blockack_s {
+    unsigned int base_id;       // sequence number of bit 0
+    unsigned int span;          // number of ids covered, [0,BLOCKACK_MAX_SPAN]
+    unsigned char acked[BLOCKACK_BITMAP_LEN];
+    unsigned char nacked[BLOCKACK_BITMAP_LEN];
+    float evm;                  // receiver EVM of recent frames [dB]
+    float rssi;                 // receiver RSSI of recent frames [dB]
+};
+
+// clear block ack and set its base packet id
+void blockack_init(blockack_s * _q, unsigned int _base_id);
+
+// set link quality reported with the block ack
+void blockack_set_link_quality(blockack_s * _q, float _evm, float _rssi);
+
+// mark packet as received (_ack=1) or failed (_ack=0); returns 0 if
+// the id lies outside the span this block ack can describe
+int blockack_add(blockack_s * _q, unsigned int _id, int _ack);
+
+// is the block ack empty?
+int blockack_empty(blockack_s * _q);
+
+// write frame header for session _session and payload; returns the
+// payload length
+unsigned int blockack_encode(blockack_s *   _q,
+                             unsigned int    _session,
+                             unsigned char * _header,
+                             unsigned char * _payload);
+
+// parse received frame; returns 0 if it is not a valid block ack
+int blockack_decode(blockack_s *          _q,
+                    const frameheader_s * _header,
+                    unsigned char * _payload,
+                    unsigned int    _payload_len);
+
+// get status of the i-th id covered by the block ack
+int blockack_is_acked(blockack_s * _q, unsigned int _i);
+int blockack_is_nacked(blockack_s * _q, unsigned int _i);
+
+#endif // __BLOCKACK_H__
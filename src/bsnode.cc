@@ -0,0 +1,851 @@
+//
+// bsnode
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <iostream>
+#include "timer.h"
+#include "frameheader.h"
+#include "blockack.h"
+#include "inflight.h"
+#include "timerwheel.h"
+#include "event.h"
+#include "spscq.h"
+#include "aggregator.h"
+#include "rto.h"
+#include "datasource.h"
+#include "erasure.h"
+#include "bsnode.h"
+
+#define lock(s) pthread_mutex_lock(s)
+#define unlock(s) pthread_mutex_unlock(s)
+
+// bounds of the adaptive timeouts: two timer wheel ticks up to a
+// minute [s]
+#define BSNODE_MIN_TIMEOUT 0.02f
+#define BSNODE_MAX_TIMEOUT 60.0f
+
+#define READY_TO_TX 1
+#define WAITING_FOR_ACK 2
+
+// per-uav link state
+struct bsnode_session_s {
+	inflight transmitted_packets;
+	timerwheel retransmit_timers;
+	spscq retransmit_packets;           // nacked ids, from callback to main loop
+	ratectl rate;                       // modulation and coding for this uav
+	aggregator messages;                // messages waiting for a frame
+	unsigned int num_messages_queued;   // messages taken from the source
+	datasource input;                   // payload bytes for this uav
+	bool input_done;                    // input used up
+	unsigned char * msg;                // message read from the input
+	const unsigned char * msg_data;     // that message, or where it is mapped
+	unsigned int msg_pending;           // its length until it is queued
+	unsigned int pid;
+	rto_s rto;                          // timeouts measured on this uav's acks
+	erasure_encoder repair_code;        // NULL without erasure coding
+	unsigned int block_first;           // id of the block's first frame
+	unsigned int repairs_pending;       // repair frames of the block to send
+	unsigned char * repair;             // payload of the repair frame
+
+	// counters, bumped atomically so stats can be read while running
+	unsigned int received_acks;
+	unsigned int num_delivered;
+	unsigned int num_bytes_delivered;
+	unsigned int received_nacks;
+	unsigned int timeouts;
+	unsigned int num_transmissions;
+	unsigned int num_repairs;
+	float runtime;
+	bool done;
+};
+
+struct bsnode_s {
+	bsnode_props_s props;
+	evlog event_log;
+
+	// guards the sessions, the scheduler and state
+	pthread_mutex_t transmitted_packets_mutex;
+	bsnode_session_s * sessions;
+	scheduler airtime;
+	int * ready;                        // sessions with a frame to send
+	ratectl_rate_s fixed_rate;          // ms/fec from props, without rate_adapt
+	event tx_event;                     // raised by callback when a uav responds
+	transceiver * txcvr;                // set while bsnode_run() sends, so acked
+	                                    // frames can be dropped from its cache
+	histogram_s rtt;                    // ack round-trip times [s]
+	histogram_s evm;                    // EVM the uavs report [dB]
+	histogram_s rssi;                   // RSSI the uavs report [dB]
+
+	long long start;                    // when bsnode_run() began [ns]
+	float runtime;
+	unsigned int state;
+	int stopped;                        // set by bsnode_stop()
+};
+
+// base station defaults
+void bsnode_props_init_default(bsnode_props_s * _props)
+{
+	_props->num_uavs = 1;
+	_props->scheduler = SCHEDULER_ROUND_ROBIN;
+	_props->num_frames = 1000;
+	_props->payload_len = 4096;
+	_props->msg_len = 0;
+	_props->num_messages = 10000;
+	_props->msg_rate = 0;
+	_props->aggregate_delay = 0.01f;
+	_props->ms = LIQUID_MODEM_BPSK;
+	_props->fec0 = LIQUID_FEC_NONE;
+	_props->fec1 = LIQUID_FEC_RS_M8;
+	_props->rate_adapt = false;
+	_props->packet_timeout = 1.0;
+	_props->response_timeout = .2;
+	_props->adaptive_timeouts = true;
+	_props->input = NULL;
+	_props->seed = 1;
+	_props->window_size = 1;
+	_props->erasure_k = 0;
+	_props->erasure_r = 0;
+	_props->verbose = false;
+}
+
+// create base station
+bsnode bsnode_create(bsnode_props_s * _props, evlog _log)
+{
+	bsnode q = (bsnode) malloc(sizeof(struct bsnode_s));
+	q->props = *_props;
+	q->event_log = _log;
+
+	pthread_mutex_init(&q->transmitted_packets_mutex, NULL);
+	q->tx_event = event_create();
+	q->sessions = (bsnode_session_s*) malloc(q->props.num_uavs*sizeof(bsnode_session_s));
+	unsigned int s;
+	for(s=0; s<q->props.num_uavs; s++)
+	{
+		bsnode_session_s * ss = &q->sessions[s];
+		// table of unacknowledged packets, one slot and payload buffer
+		// per window position
+		ss->transmitted_packets = inflight_create(q->props.window_size, q->props.payload_len);
+		// retransmission deadlines for the same packets, 10 ms resolution
+		ss->retransmit_timers = timerwheel_create(0.01f, 256, q->props.window_size);
+		ss->retransmit_packets = spscq_create(2*q->props.window_size);
+		ss->rate = ratectl_create();
+		ss->messages = aggregator_create(q->props.payload_len, q->props.aggregate_delay);
+		ss->num_messages_queued = 0;
+		// every uav gets the whole input, or its own random stream; an
+		// input that has to be read as it comes wakes the main loop
+		if(q->props.input != NULL)
+		{
+			ss->input = datasource_create_file(q->props.input, q->props.msg_len > 0 ? q->props.msg_len : q->props.payload_len, q->tx_event);
+			if(ss->input == NULL)
+			{
+				fprintf(stderr,"error: bsnode_create(), could not open '%s'\n", q->props.input);
+				exit(1);
+			}
+		}
+		else
+		{
+			ss->input = datasource_create_random(q->props.seed + s);
+		}
+		ss->input_done = false;
+		ss->msg = (unsigned char*) malloc(q->props.msg_len > 0 ? q->props.msg_len : 1);
+		ss->msg_data = NULL;
+		ss->msg_pending = 0;
+		ss->pid = 0;
+		rto_init(&ss->rto, q->props.packet_timeout, BSNODE_MIN_TIMEOUT, BSNODE_MAX_TIMEOUT);
+		ss->repair_code = NULL;
+		ss->repair = NULL;
+		if(q->props.erasure_k > 0 && q->props.erasure_r > 0)
+		{
+			ss->repair_code = erasure_encoder_create(q->props.erasure_k, q->props.erasure_r, q->props.payload_len);
+			ss->repair = (unsigned char*) malloc(q->props.payload_len + ERASURE_OVERHEAD);
+		}
+		ss->block_first = 0;
+		ss->repairs_pending = 0;
+		ss->received_acks = 0;
+		ss->num_delivered = 0;
+		ss->num_bytes_delivered = 0;
+		ss->received_nacks = 0;
+		ss->timeouts = 0;
+		ss->num_transmissions = 0;
+		ss->num_repairs = 0;
+		ss->runtime = 0;
+		ss->done = false;
+	}
+	q->airtime = scheduler_create(q->props.num_uavs, q->props.scheduler);
+	q->ready = (int*) malloc(q->props.num_uavs*sizeof(int));
+	ratectl_rate_init(&q->fixed_rate, q->props.ms, q->props.fec0, q->props.fec1);
+	q->txcvr = NULL;
+	histogram_init(&q->rtt, 1e-4f, 100.0f, 1);
+	histogram_init(&q->evm, -40.0f, 0.0f, 0);
+	histogram_init(&q->rssi, -100.0f, 20.0f, 0);
+
+	q->start = 0;
+	q->runtime = 0;
+	q->state = READY_TO_TX;
+	q->stopped = 0;
+	return q;
+}
+
+// destroy base station
+void bsnode_destroy(bsnode _q)
+{
+	unsigned int s;
+	for(s=0; s<_q->props.num_uavs; s++)
+	{
+		ratectl_destroy(_q->sessions[s].rate);
+		aggregator_destroy(_q->sessions[s].messages);
+		datasource_destroy(_q->sessions[s].input);
+		free(_q->sessions[s].msg);
+		if(_q->sessions[s].repair_code != NULL)
+			erasure_encoder_destroy(_q->sessions[s].repair_code);
+		free(_q->sessions[s].repair);
+		spscq_destroy(_q->sessions[s].retransmit_packets);
+		timerwheel_destroy(_q->sessions[s].retransmit_timers);
+		inflight_destroy(_q->sessions[s].transmitted_packets);
+	}
+	event_destroy(_q->tx_event);
+	scheduler_destroy(_q->airtime);
+	free(_q->ready);
+	free(_q->sessions);
+	pthread_mutex_destroy(&_q->transmitted_packets_mutex);
+	free(_q);
+}
+
+// key a frame is cached under by the transceiver
+static unsigned long long bsnode_frame_key(unsigned int _session, unsigned int _id)
+{
+	return ((unsigned long long)_session << 32) | _id;
+}
+
+// send a data frame from its payload under the packet's cache key. A
+// slice of a mapped input outlives any queue, so only its pointer is
+// passed on; the packet's slot buffer is reused once the packet is
+// acked, so a queueing transceiver copies it.
+static void bsnode_transmit_data(transceiver *          _txcvr,
+                                 unsigned int           _session,
+                                 unsigned char *        _header,
+                                 packet *               _pk,
+                                 const ratectl_rate_s * _r)
+{
+	if(_pk->borrowed)
+		_txcvr->transmit_borrowed_packet(bsnode_frame_key(_session, _pk->id), _header, _pk->data, _pk->len, _r->ms, _r->fec0, _r->fec1);
+	else
+		_txcvr->transmit_cached_packet(bsnode_frame_key(_session, _pk->id), _header, _pk->data, _pk->len, _r->ms, _r->fec0, _r->fec1);
+}
+
+// packet acknowledged: stop its retransmission timer, free its slot and
+// drop its cached samples (transmitted_packets_mutex must be held)
+static void bsnode_packet_acked(bsnode _q, unsigned int _session, unsigned int _id)
+{
+	bsnode_session_s * ss = &_q->sessions[_session];
+	packet * pk = inflight_get(ss->transmitted_packets, _id);
+	if(pk == NULL)
+		return;
+	// an ack for a resent frame may answer any of its copies, so only
+	// first transmissions give round-trip times
+	if(pk->tx_attempts == 1)
+	{
+		float rtt = (timer_now_ns() - pk->tx_time) * 1e-9f;
+		histogram_add(&_q->rtt, rtt);
+		rto_sample(&ss->rto, rtt);
+	}
+	evlog_write(_q->event_log, EVLOG_ACK, _session, _id, pk->tx_attempts, 0, 0);
+	__atomic_add_fetch(&ss->num_delivered, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&ss->num_bytes_delivered, pk->len, __ATOMIC_RELAXED);
+	timerwheel_cancel(ss->retransmit_timers, pk->id);
+	inflight_remove(ss->transmitted_packets, _id);
+	if(_q->txcvr != NULL)
+		_q->txcvr->release_cached_packet(bsnode_frame_key(_session, _id));
+}
+
+int bsnode_callback(unsigned char *  _header,
+		int              _header_valid,
+		unsigned char *  _payload,
+		unsigned int     _payload_len,
+		int              _payload_valid,
+		framesyncstats_s _stats,
+		void *           _userdata)
+{
+	bsnode q = (bsnode) _userdata;
+	if(_header_valid)
+	{
+		frameheader_s h;
+		frameheader_decode(&h, _header);
+		unsigned int session = h.session;
+		if(session >= q->props.num_uavs)
+			return 0;
+		bsnode_session_s * ss = &q->sessions[session];
+		unsigned int rx_id = h.seq;
+		if(h.type == FRAMEHEADER_TYPE_ACK)
+		{
+			// ack slides the window past this packet only
+			lock(&q->transmitted_packets_mutex);
+			bsnode_packet_acked(q, session, rx_id);
+			scheduler_report(q->airtime, session, 1);
+			ratectl_ack(ss->rate);
+			q->state = READY_TO_TX;
+			unlock(&q->transmitted_packets_mutex);
+			event_signal(q->tx_event);
+			__atomic_add_fetch(&ss->received_acks, 1, __ATOMIC_RELAXED);
+		}
+		else if(h.type == FRAMEHEADER_TYPE_NACK)
+		{
+			// nack queues just this packet for retransmission (if the
+			// queue is full the retransmission timer still recovers it)
+			spscq_push(ss->retransmit_packets, rx_id);
+			__atomic_add_fetch(&ss->received_nacks, 1, __ATOMIC_RELAXED);
+			lock(&q->transmitted_packets_mutex);
+			scheduler_report(q->airtime, session, 0);
+			q->state = READY_TO_TX;
+			unlock(&q->transmitted_packets_mutex);
+			event_signal(q->tx_event);
+		}
+		else if(h.type == FRAMEHEADER_TYPE_BLOCKACK && _payload_valid)
+		{
+			// one frame answering for a whole run of packets
+			blockack_s ba;
+			if(!blockack_decode(&ba, &h, _payload, _payload_len))
+				return 0;
+			unsigned int i;
+			unsigned int id;
+			unsigned int num_acked = 0;
+			unsigned int num_nacked = 0;
+			histogram_add(&q->evm, ba.evm);
+			histogram_add(&q->rssi, ba.rssi);
+			lock(&q->transmitted_packets_mutex);
+			ratectl_update(ss->rate, ba.evm);
+			for(i=0; i<ba.span; i++)
+			{
+				id = ba.base_id + i;
+				if(blockack_is_acked(&ba, i))
+				{
+					bsnode_packet_acked(q, session, id);
+					scheduler_report(q->airtime, session, 1);
+					__atomic_add_fetch(&ss->received_acks, 1, __ATOMIC_RELAXED);
+					num_acked++;
+				}
+				else if(blockack_is_nacked(&ba, i))
+				{
+					spscq_push(ss->retransmit_packets, id);
+					scheduler_report(q->airtime, session, 0);
+					__atomic_add_fetch(&ss->received_nacks, 1, __ATOMIC_RELAXED);
+					num_nacked++;
+				}
+			}
+			// the whole report is one loss event at most
+			ratectl_report(ss->rate, num_acked, num_nacked);
+			q->state = READY_TO_TX;
+			unlock(&q->transmitted_packets_mutex);
+			event_signal(q->tx_event);
+		}
+	}
+	return 0;
+}
+
+// number of frames or messages to send each uav: as many as the input
+// holds, else the number configured
+static unsigned int bsnode_frame_limit(bsnode _q)
+{
+	return _q->props.input != NULL ? UINT_MAX : _q->props.num_frames;
+}
+
+static unsigned int bsnode_message_limit(bsnode _q)
+{
+	return _q->props.input != NULL ? UINT_MAX : _q->props.num_messages;
+}
+
+// number of messages the source has produced by now: all of them at
+// once when msg_rate is 0, else msg_rate per second
+static unsigned int bsnode_messages_available(bsnode _q)
+{
+	unsigned int limit = bsnode_message_limit(_q);
+	if(_q->props.msg_rate <= 0)
+		return limit;
+	double n = (timer_now_ns() - _q->start) * 1e-9 * _q->props.msg_rate;
+	return n < limit ? (unsigned int)n : limit;
+}
+
+// seconds until the source produces the session's next message, -1 if
+// it has no more
+static float bsnode_next_message_timeout(bsnode _q, bsnode_session_s * _ss)
+{
+	if(_ss->input_done || _ss->num_messages_queued >= bsnode_message_limit(_q) || _q->props.msg_rate <= 0)
+		return -1.0f;
+	float t = (_ss->num_messages_queued + 1) / _q->props.msg_rate - (timer_now_ns() - _q->start) * 1e-9f;
+	return t > 0 ? t : 0.0f;
+}
+
+// can the session's next message or frame be taken from the input
+// without waiting? The input is read with transmitted_packets_mutex
+// held, so a slow producer must never make the callback wait for it.
+static int bsnode_session_input_ready(bsnode _q, bsnode_session_s * _ss)
+{
+	return datasource_ready(_ss->input, _q->props.msg_len > 0 ? _q->props.msg_len : _q->props.payload_len);
+}
+
+// move messages the source has produced into the session's next frame
+// (transmitted_packets_mutex must be held)
+static void bsnode_session_pull(bsnode _q, bsnode_session_s * _ss)
+{
+	unsigned int available = bsnode_messages_available(_q);
+	while(!_ss->input_done && _ss->num_messages_queued < available)
+	{
+		// a message that did not fit the last frame waits for the next
+		if(_ss->msg_pending == 0 && !bsnode_session_input_ready(_q, _ss))
+			break;
+		if(_ss->msg_pending == 0)
+			_ss->msg_pending = datasource_read(_ss->input, _ss->msg, _q->props.msg_len, &_ss->msg_data);
+		if(_ss->msg_pending == 0)
+		{
+			_ss->input_done = true;
+			break;
+		}
+		if(!aggregator_push(_ss->messages, _ss->msg_data, _ss->msg_pending))
+			break;
+		_ss->msg_pending = 0;
+		_ss->num_messages_queued++;
+	}
+	// nothing else is coming: send what there is
+	if(_ss->input_done || _ss->num_messages_queued == bsnode_message_limit(_q))
+		aggregator_close(_ss->messages);
+}
+
+// does session have data it has not sent yet?
+static int bsnode_session_has_new(bsnode _q, bsnode_session_s * _ss)
+{
+	if(_q->props.msg_len == 0)
+		return !_ss->input_done && _ss->pid < bsnode_frame_limit(_q);
+	return (!_ss->input_done && _ss->num_messages_queued < bsnode_message_limit(_q)) ||
+	       aggregator_size(_ss->messages) > 0;
+}
+
+// can session send a new frame now?
+// (transmitted_packets_mutex must be held)
+static int bsnode_session_can_send_new(bsnode _q, bsnode_session_s * _ss)
+{
+	if(_ss->pid - inflight_base(_ss->transmitted_packets) >= _q->props.window_size)
+		return 0;
+	if(_q->props.msg_len == 0)
+		return bsnode_session_has_new(_q, _ss) && bsnode_session_input_ready(_q, _ss);
+	bsnode_session_pull(_q, _ss);
+	return aggregator_next_timeout(_ss->messages) == 0;
+}
+
+// should the repair frames of the session's block go out? Once the
+// block is full, or before then if no new frame could follow it now
+// (transmitted_packets_mutex must be held)
+static int bsnode_session_repair_due(bsnode _q, bsnode_session_s * _ss)
+{
+	if(_ss->repair_code == NULL)
+		return 0;
+	if(_ss->repairs_pending > 0)
+		return 1;
+	unsigned int n = erasure_encoder_size(_ss->repair_code);
+	return n > 0 && (n == _q->props.erasure_k ||
+	                 _ss->pid - inflight_base(_ss->transmitted_packets) >= _q->props.window_size ||
+	                 !bsnode_session_has_new(_q, _ss) ||
+	                 (_q->props.msg_len == 0 && !bsnode_session_input_ready(_q, _ss)));
+}
+
+// does session have a retransmission, repair or new frame to send?
+// (transmitted_packets_mutex must be held)
+static int bsnode_session_ready(bsnode _q, bsnode_session_s * _ss)
+{
+	return spscq_size(_ss->retransmit_packets) > 0 ||
+	       timerwheel_next_timeout(_ss->retransmit_timers) == 0 ||
+	       bsnode_session_repair_due(_q, _ss) ||
+	       bsnode_session_can_send_new(_q, _ss);
+}
+
+// time to wait before resending a frame to the session
+// (transmitted_packets_mutex must be held)
+static float bsnode_retransmit_timeout(bsnode _q, bsnode_session_s * _ss)
+{
+	return _q->props.adaptive_timeouts ? rto_get(&_ss->rto) : _q->props.packet_timeout;
+}
+
+// time to wait for any uav to respond before looking for work again:
+// the shortest measured response time, the configured one until
+// there is none (transmitted_packets_mutex must be held)
+static float bsnode_response_timeout(bsnode _q)
+{
+	if(!_q->props.adaptive_timeouts)
+		return _q->props.response_timeout;
+	float timeout = -1.0f;
+	float t;
+	unsigned int s;
+	for(s=0; s<_q->props.num_uavs; s++)
+	{
+		t = rto_get_response(&_q->sessions[s].rto);
+		if(t >= 0 && (timeout < 0 || t < timeout))
+			timeout = t;
+	}
+	return timeout < 0 ? _q->props.response_timeout : timeout;
+}
+
+// modulation and coding for the session's next frame
+static const ratectl_rate_s * bsnode_session_rate(bsnode _q, bsnode_session_s * _ss)
+{
+	return _q->props.rate_adapt ? ratectl_get(_ss->rate) : &_q->fixed_rate;
+}
+
+// send the session's next frame: a retransmission if one is due, else
+// a repair frame of the block, else a new frame if the window allows;
+// returns the frame's rate and sets
+// its payload length, or returns NULL if nothing was sent
+// (transmitted_packets_mutex must be held)
+static const ratectl_rate_s * bsnode_session_transmit(bsnode         _q,
+                                                      unsigned int   _session,
+                                                      transceiver *  _txcvr,
+                                                      unsigned int * _len)
+{
+	bsnode_props_s * props = &_q->props;
+	bsnode_session_s * ss = &_q->sessions[_session];
+	const ratectl_rate_s * r;
+	unsigned char header[FRAMEHEADER_LEN];
+	frameheader_s h;
+	unsigned int id;
+	packet * pk;
+
+	h.type = FRAMEHEADER_TYPE_DATA;
+	h.session = _session;
+	h.flags = props->msg_len > 0 ? FRAMEHEADER_FLAG_AGGREGATED : 0;
+
+	// selective repeat: only the packets that were nacked or timed out
+	// are resent, everything else in the window stays put
+	while(1)
+	{
+		if(spscq_pop(ss->retransmit_packets, &id))
+		{
+			pk = inflight_get(ss->transmitted_packets, id);
+		}
+		else if(timerwheel_pop(ss->retransmit_timers, &id))
+		{
+			pk = inflight_get(ss->transmitted_packets, id);
+			if(pk != NULL)
+			{
+				// a burst of timeouts is one loss event, like one backoff
+				if(rto_backoff(&ss->rto, pk->tx_time, timer_now_ns()))
+					ratectl_loss(ss->rate);
+				__atomic_add_fetch(&ss->timeouts, 1, __ATOMIC_RELAXED);
+				scheduler_report(_q->airtime, _session, 0);
+			}
+		}
+		else
+		{
+			break;
+		}
+		if(pk != NULL)
+		{
+			pk->tx_attempts++;
+			timerwheel_schedule(ss->retransmit_timers, pk->id, bsnode_retransmit_timeout(_q, ss));
+			pk->tx_time = timer_now_ns();
+			h.seq = pk->id;
+			h.info = pk->tx_attempts;
+			frameheader_encode(&h, header);
+
+			if(props->verbose)std::cout << "re-tx packet id: " << id << ", uav: " << _session << std::endl;
+			r = bsnode_session_rate(_q, ss);
+			bsnode_transmit_data(_txcvr, _session, header, pk, r);
+			evlog_write(_q->event_log, EVLOG_TX, _session, pk->id, pk->tx_attempts, 0, 0);
+			__atomic_add_fetch(&ss->num_transmissions, 1, __ATOMIC_RELAXED);
+			*_len = pk->len;
+			return r;
+		}
+	}
+
+	// repair frames are sent once each and never acknowledged: they only
+	// save the uav from waiting for retransmissions
+	if(bsnode_session_repair_due(_q, ss))
+	{
+		if(ss->repairs_pending == 0)
+			ss->repairs_pending = props->erasure_r;
+		unsigned int index = props->erasure_r - ss->repairs_pending;
+		unsigned int len = erasure_encoder_repair(ss->repair_code, index, ss->repair);
+		h.type = FRAMEHEADER_TYPE_REPAIR;
+		h.seq = ss->block_first;
+		h.info = index;
+		frameheader_encode(&h, header);
+
+		if(props->verbose)
+			printf("tx repair %u of block %u, uav: %u\n", index, ss->block_first, _session);
+		r = bsnode_session_rate(_q, ss);
+		_txcvr->transmit_packet(header, ss->repair, len, r->ms, r->fec0, r->fec1);
+		__atomic_add_fetch(&ss->num_transmissions, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&ss->num_repairs, 1, __ATOMIC_RELAXED);
+		if(--ss->repairs_pending == 0)
+			erasure_encoder_reset(ss->repair_code);
+		*_len = len;
+		return r;
+	}
+
+	// keep new frames going out while acks for earlier ones come back
+	if(bsnode_session_can_send_new(_q, ss))
+	{
+		// fill the payload: the waiting messages, written into the
+		// packet's slot, or the next slice of the input, which a mapped
+		// file hands over in place
+		pk = inflight_insert(ss->transmitted_packets, ss->pid);
+		if(props->msg_len > 0)
+		{
+			pk->len = aggregator_flush(ss->messages, pk->data);
+		}
+		else
+		{
+			const unsigned char * data;
+			pk->len = datasource_read(ss->input, pk->data, props->payload_len, &data);
+			pk->borrowed = data != pk->data;
+			pk->data = (unsigned char*)data;
+			if(pk->len == 0)
+			{
+				// input used up: nothing to send after all
+				inflight_remove(ss->transmitted_packets, ss->pid);
+				ss->input_done = true;
+				return NULL;
+			}
+		}
+		pk->tx_attempts = 1;
+		if(ss->repair_code != NULL && erasure_encoder_add(ss->repair_code, pk->data, pk->len) == 1)
+			ss->block_first = ss->pid;
+
+		if (props->verbose)
+			printf("tx packet id: %6u, uav: %u\n", ss->pid, _session);
+
+		// write header
+		h.seq = ss->pid;
+		h.info = 1;
+		frameheader_encode(&h, header);
+
+		timerwheel_schedule(ss->retransmit_timers, pk->id, bsnode_retransmit_timeout(_q, ss));
+		pk->tx_time = timer_now_ns();
+		// transmit frame straight from the payload
+		r = bsnode_session_rate(_q, ss);
+		bsnode_transmit_data(_txcvr, _session, header, pk, r);
+		evlog_write(_q->event_log, EVLOG_TX, _session, pk->id, pk->tx_attempts, 0, 0);
+		__atomic_add_fetch(&ss->num_transmissions, 1, __ATOMIC_RELAXED);
+		ss->pid++;
+		*_len = pk->len;
+		return r;
+	}
+	return NULL;
+}
+
+// have all sessions delivered every frame? notes when each one finishes
+// (transmitted_packets_mutex must be held)
+static bool bsnode_done(bsnode _q, timer _run_timer)
+{
+	bool done = true;
+	unsigned int s;
+	for(s=0; s<_q->props.num_uavs; s++)
+	{
+		bsnode_session_s * ss = &_q->sessions[s];
+		if(!ss->done && !bsnode_session_has_new(_q, ss) && inflight_size(ss->transmitted_packets) == 0)
+		{
+			ss->done = true;
+			float runtime = timer_toc(_run_timer);
+			__atomic_store(&ss->runtime, &runtime, __ATOMIC_RELAXED);
+		}
+		done = done && ss->done;
+	}
+	return done;
+}
+
+// send every frame to every uav and return once all are acknowledged
+void bsnode_run(bsnode _q, transceiver * _txcvr)
+{
+	bsnode_props_s * props = &_q->props;
+
+	timer run_timer = timer_create();
+	timer_tic(run_timer);
+	timer pid_timer = timer_create();
+	timer_tic(pid_timer);
+	_q->start = timer_now_ns();
+	lock(&_q->transmitted_packets_mutex);
+	_q->txcvr = _txcvr;
+	unlock(&_q->transmitted_packets_mutex);
+
+	unsigned int s;
+	int next;
+	const ratectl_rate_s * rate;
+	unsigned int len;
+	float timeout;
+	float next_timeout;
+	float response_timeout;
+	while (1)
+	{
+		lock(&_q->transmitted_packets_mutex);
+		bool done = bsnode_done(_q, run_timer);
+		unlock(&_q->transmitted_packets_mutex);
+		if(done || __atomic_load_n(&_q->stopped, __ATOMIC_ACQUIRE))
+			break;
+
+		if(_q->state == WAITING_FOR_ACK)
+		{
+			// sleep until a uav responds, a retransmission or a frame
+			// of messages falls due, or the response timeout runs out
+			lock(&_q->transmitted_packets_mutex);
+			response_timeout = bsnode_response_timeout(_q);
+			timeout = response_timeout - timer_toc(pid_timer);
+			for(s=0; s<props->num_uavs; s++)
+			{
+				next_timeout = timerwheel_next_timeout(_q->sessions[s].retransmit_timers);
+				if(next_timeout >= 0 && next_timeout < timeout)
+					timeout = next_timeout;
+				// a frame that is due has to wait for window space anyway
+				if(props->msg_len == 0 || _q->sessions[s].pid - inflight_base(_q->sessions[s].transmitted_packets) >= props->window_size)
+					continue;
+				next_timeout = aggregator_next_timeout(_q->sessions[s].messages);
+				if(next_timeout >= 0 && next_timeout < timeout)
+					timeout = next_timeout;
+				next_timeout = bsnode_next_message_timeout(_q, &_q->sessions[s]);
+				if(next_timeout >= 0 && next_timeout < timeout)
+					timeout = next_timeout;
+			}
+			unlock(&_q->transmitted_packets_mutex);
+			if(timeout > 0)
+				event_wait(_q->tx_event, timeout);
+			if(timer_toc(pid_timer) > response_timeout)
+				timer_tic(pid_timer);
+			lock(&_q->transmitted_packets_mutex);
+			_q->state = READY_TO_TX;
+			unlock(&_q->transmitted_packets_mutex);
+		}
+		if(_q->state == READY_TO_TX)
+		{
+			// backpressure from the transmitter: wait for room in its
+			// queue before choosing a frame, without holding the lock
+			// the callback needs, so the choice sees the latest acks
+			_txcvr->wait_tx_ready();
+			lock(&_q->transmitted_packets_mutex);
+			for(s=0; s<props->num_uavs; s++)
+			{
+				timerwheel_advance(_q->sessions[s].retransmit_timers);
+				_q->ready[s] = bsnode_session_ready(_q, &_q->sessions[s]);
+			}
+
+			// one frame per decision, so the scheduler sees every ack
+			// that arrives in between
+			next = scheduler_next(_q->airtime, _q->ready);
+			if(next < 0)
+			{
+				// every window full (or nothing new left): wait for
+				// the uavs to respond
+				_q->state = WAITING_FOR_ACK;
+			}
+			else if((rate = bsnode_session_transmit(_q, next, _txcvr, &len)) != NULL)
+			{
+				scheduler_charge(_q->airtime, next, 8.0f*len, ratectl_airtime(rate, len));
+				timer_tic(pid_timer);
+			}
+			unlock(&_q->transmitted_packets_mutex);
+		}
+	} // packet loop
+
+	lock(&_q->transmitted_packets_mutex);
+	_q->txcvr = NULL;
+	unlock(&_q->transmitted_packets_mutex);
+	float runtime = timer_toc(run_timer);
+	__atomic_store(&_q->runtime, &runtime, __ATOMIC_RELAXED);
+	timer_destroy(pid_timer);
+	timer_destroy(run_timer);
+}
+
+// make bsnode_run() return without waiting for the remaining acks
+void bsnode_stop(bsnode _q)
+{
+	__atomic_store_n(&_q->stopped, 1, __ATOMIC_RELEASE);
+	event_signal(_q->tx_event);
+}
+
+// get link counters summed over all sessions
+void bsnode_get_stats(bsnode _q, bsnode_stats_s * _stats)
+{
+	bsnode_stats_s s;
+	unsigned int i;
+	_stats->received_acks = 0;
+	_stats->received_nacks = 0;
+	_stats->timeouts = 0;
+	_stats->num_transmissions = 0;
+	_stats->num_delivered = 0;
+	_stats->num_bytes_delivered = 0;
+	_stats->num_repairs = 0;
+	for(i=0; i<_q->props.num_uavs; i++)
+	{
+		bsnode_get_session_stats(_q, i, &s);
+		_stats->received_acks += s.received_acks;
+		_stats->received_nacks += s.received_nacks;
+		_stats->timeouts += s.timeouts;
+		_stats->num_transmissions += s.num_transmissions;
+		_stats->num_delivered += s.num_delivered;
+		_stats->num_bytes_delivered += s.num_bytes_delivered;
+		_stats->num_repairs += s.num_repairs;
+	}
+	__atomic_load(&_q->runtime, &_stats->runtime, __ATOMIC_RELAXED);
+}
+
+// get link counters of one session
+void bsnode_get_session_stats(bsnode           _q,
+                              unsigned int     _session,
+                              bsnode_stats_s * _stats)
+{
+	bsnode_session_s * ss = &_q->sessions[_session];
+	_stats->received_acks = __atomic_load_n(&ss->received_acks, __ATOMIC_RELAXED);
+	_stats->received_nacks = __atomic_load_n(&ss->received_nacks, __ATOMIC_RELAXED);
+	_stats->timeouts = __atomic_load_n(&ss->timeouts, __ATOMIC_RELAXED);
+	_stats->num_transmissions = __atomic_load_n(&ss->num_transmissions, __ATOMIC_RELAXED);
+	_stats->num_delivered = __atomic_load_n(&ss->num_delivered, __ATOMIC_RELAXED);
+	_stats->num_bytes_delivered = __atomic_load_n(&ss->num_bytes_delivered, __ATOMIC_RELAXED);
+	_stats->num_repairs = __atomic_load_n(&ss->num_repairs, __ATOMIC_RELAXED);
+	__atomic_load(&ss->runtime, &_stats->runtime, __ATOMIC_RELAXED);
+}
+
+// get ack round-trip times
+void bsnode_get_rtt(bsnode _q, histogram_s * _rtt)
+{
+	histogram_copy(_rtt, &_q->rtt);
+}
+
+// get link quality the uavs report
+void bsnode_get_link_quality(bsnode _q, histogram_s * _evm, histogram_s * _rssi)
+{
+	histogram_copy(_evm, &_q->evm);
+	histogram_copy(_rssi, &_q->rssi);
+}
+
+// print link counters
+void bsnode_print_stats(bsnode _q)
+{
+	bsnode_stats_s s;
+	bsnode_get_stats(_q, &s);
+	std::cout << "Received " << s.received_acks << " acks." << std::endl;
+	std::cout << "Received " << s.received_nacks << " nacks." << std::endl;
+	std::cout << s.timeouts << " packets timed out and were retransmitted." << std::endl;
+	if(_q->props.erasure_k > 0 && _q->props.erasure_r > 0)
+		std::cout << "Sent " << s.num_repairs << " erasure repair frames." << std::endl;
+	if(histogram_count(&_q->rtt) > 0)
+		printf("Ack round-trip time: %.2f ms median, %.2f ms 99th percentile.\n",
+				histogram_percentile(&_q->rtt, 0.5f)*1e3f, histogram_percentile(&_q->rtt, 0.99f)*1e3f);
+	if(histogram_count(&_q->evm) > 0)
+		printf("Reported link quality: %.1f dB mean EVM, %.1f dB mean RSSI.\n",
+				histogram_mean(&_q->evm), histogram_mean(&_q->rssi));
+	if(_q->props.adaptive_timeouts && _q->props.num_uavs == 1)
+		printf("Smoothed round-trip time %.2f ms, retransmission timeout %.2f ms.\n",
+				_q->sessions[0].rto.srtt*1e3f, rto_get(&_q->sessions[0].rto)*1e3f);
+	if(_q->props.num_uavs == 1)
+		return;
+
+	unsigned int i;
+	for(i=0; i<_q->props.num_uavs; i++)
+	{
+		bsnode_get_session_stats(_q, i, &s);
+		printf("    uav %2u: %6u acks, %6u nacks, %6u timeouts, %6u transmissions, done after %f s",
+				i, s.received_acks, s.received_nacks, s.timeouts, s.num_transmissions, s.runtime);
+		if(_q->props.adaptive_timeouts)
+			printf(", srtt %.2f ms", _q->sessions[i].rto.srtt*1e3f);
+		printf("\n");
+	}
+}
@@ -0,0 +1,118 @@
+//
+// bsnode
+//
+// Base station side of the ARQ link: sends a stream of data frames to
+// each of its UAVs over any transceiver and retransmits whatever a UAV
+// nacks or never acknowledges. Every UAV has its own session with its
+// own sequence space and window, and a scheduler shares the airtime
+// between sessions.
+//
+
+#ifndef __BSNODE_H__
+#define __BSNODE_H__
+
+#include "transceiver.h"
+#include "evlog.h"
+#include "session.h"
+#include "scheduler.h"
+#include "ratectl.h"
+#include "histogram.h"
+
+struct bsnode_props_s {
+    unsigned int num_uavs;          // number of sessions, [1,SESSION_MAX]
+    int scheduler;                  // SCHEDULER_* airtime policy
+    unsigned int num_frames;        // number of frames to deliver per uav
+    const char * input;             // send the bytes of this file ("-" for
+                                    // stdin) to every uav, as frames or
+                                    // messages, instead of num_frames or
+                                    // num_messages of random data; NULL
+                                    // for random data
+    unsigned int seed;              // seed of the random data
+    unsigned int payload_len;       // payload bytes per frame (the most
+                                    // when aggregating messages)
+    unsigned int msg_len;           // send messages of this many bytes,
+                                    // aggregated into frames, instead of
+                                    // num_frames full frames; 0 disables
+    unsigned int num_messages;      // number of messages to deliver per uav
+    float msg_rate;                 // messages offered per second per uav,
+                                    // 0 for all at once
+    float aggregate_delay;          // longest a message waits for others
+                                    // to share its frame [s]
+    modulation_scheme ms;           // modulation scheme
+    fec_scheme fec0;                // inner fec
+    fec_scheme fec1;                // outer fec
+    bool rate_adapt;                // pick ms/fec per frame from the
+                                    // uav's reported EVM instead
+    float packet_timeout;           // wait before retransmitting [s]
+    float response_timeout;         // wait for a response [s]
+    bool adaptive_timeouts;         // derive both timeouts from measured
+                                    // ack round-trip times, starting
+                                    // from the two above
+    unsigned int window_size;       // selective-repeat window per uav
+    unsigned int erasure_k;         // follow every erasure_k new frames
+    unsigned int erasure_r;         // with erasure_r repair frames, see
+                                    // erasure.h; 0 disables
+    bool verbose;
+};
+
+// base station defaults
+void bsnode_props_init_default(bsnode_props_s * _props);
+
+struct bsnode_stats_s {
+    unsigned int received_acks;
+    unsigned int received_nacks;
+    unsigned int timeouts;
+    unsigned int num_transmissions; // frames sent, including retransmits
+    unsigned int num_delivered;     // frames acknowledged, each once
+    unsigned int num_bytes_delivered; // payload bytes of those frames
+    unsigned int num_repairs;       // erasure repair frames sent
+    float runtime;                  // time until the last frame was
+                                    // acknowledged [s]
+};
+
+typedef struct bsnode_s * bsnode;
+
+// create base station; events are recorded to _log unless it is NULL
+bsnode bsnode_create(bsnode_props_s * _props, evlog _log);
+
+// destroy base station
+void bsnode_destroy(bsnode _q);
+
+// framesync callback for the base station's transceiver; _userdata
+// must be the bsnode
+int bsnode_callback(unsigned char *  _header,
+                    int              _header_valid,
+                    unsigned char *  _payload,
+                    unsigned int     _payload_len,
+                    int              _payload_valid,
+                    framesyncstats_s _stats,
+                    void *           _userdata);
+
+// send every frame to every uav over _txcvr and return once all are
+// acknowledged
+void bsnode_run(bsnode _q, transceiver * _txcvr);
+
+// make bsnode_run() return without waiting for the remaining acks
+// (from any thread)
+void bsnode_stop(bsnode _q);
+
+// get link counters summed over all sessions (from any thread, while
+// bsnode_run() is going)
+void bsnode_get_stats(bsnode _q, bsnode_stats_s * _stats);
+
+// get link counters of one session
+void bsnode_get_session_stats(bsnode           _q,
+                              unsigned int     _session,
+                              bsnode_stats_s * _stats);
+
+// get round-trip times [s] from sending a frame to its ack, counting
+// only frames acked on their first transmission
+void bsnode_get_rtt(bsnode _q, histogram_s * _rtt);
+
+// get EVM and RSSI [dB] the uavs report in their block acks
+void bsnode_get_link_quality(bsnode _q, histogram_s * _evm, histogram_s * _rssi);
+
+// print link counters
+void bsnode_print_stats(bsnode _q);
+
+#endif // __BSNODE_H__
@@ -1,2 +1,4 @@
-g++ -Wall -fPIC -o obj/BaseStation BaseStation.cc timer.cc -lliquid -lliquidusrp 
-g++ -Wall -fPIC -o obj/UAV UAV.cc timer.cc -lliquidusrp -lliquid 
+# builds everything in obj/ through the Makefile (LinkBench included)
+set -e
+cd "$(dirname "$0")"
+make all bench
@@ -0,0 +1,229 @@
+//
+// datasource
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "datasource.h"
+
+// least read-ahead of an unmappable input [bytes]
+#define DATASOURCE_MIN_RING (64*1024)
+
+struct datasource_s {
+    int fd;                     // input, -1 for random bytes
+    unsigned char * map;        // mapped input, NULL if read instead
+    size_t size;                // bytes mapped
+    size_t offset;              // bytes handed out so far
+    unsigned long long state;   // generator state, never 0
+
+    // read-ahead of an unmappable input, filled by the reader thread
+    unsigned char * ring;       // NULL unless read ahead
+    size_t capacity;
+    size_t head;                // oldest byte not handed out
+    size_t count;               // bytes buffered
+    int eof;                    // the reader saw the end of the input
+    int stopping;               // set by datasource_destroy()
+    event ready;                // raised when bytes arrive, may be NULL
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;        // count or eof changed
+    pthread_t reader;
+};
+
+// next 64 bits of xorshift64*
+static unsigned long long datasource_next(datasource _q)
+{
+    _q->state ^= _q->state >> 12;
+    _q->state ^= _q->state << 25;
+    _q->state ^= _q->state >> 27;
+    return _q->state * 0x2545F4914F6CDD1DULL;
+}
+
+// endless pseudo-random bytes
+datasource datasource_create_random(unsigned long long _seed)
+{
+    datasource q = (datasource) malloc(sizeof(struct datasource_s));
+    q->fd     = -1;
+    q->map    = NULL;
+    q->size   = 0;
+    q->offset = 0;
+    q->ring   = NULL;
+    // spread the seed over the state (splitmix64), so nearby seeds give
+    // unrelated sequences and 0 is never the state
+    unsigned long long z = _seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    q->state = z != 0 ? z : 1;
+    return q;
+}
+
+// fill the ring from the input until it ends or the source is
+// destroyed; only the free part of the ring is written, so the read
+// itself runs without the lock
+static void * datasource_reader(void * _arg)
+{
+    datasource q = (datasource) _arg;
+
+    // a read waiting on a quiet pipe is the only place to be cancelled
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    pthread_mutex_lock(&q->mutex);
+    while (!q->stopping && !q->eof) {
+        if (q->count == q->capacity) {
+            pthread_cond_wait(&q->cond, &q->mutex);
+            continue;
+        }
+        size_t tail = (q->head + q->count) % q->capacity;
+        size_t n = tail < q->head ? q->head - tail : q->capacity - tail;
+        pthread_mutex_unlock(&q->mutex);
+
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        ssize_t r = read(q->fd, q->ring + tail, n);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+        pthread_mutex_lock(&q->mutex);
+        if (r > 0)
+            q->count += r;
+        else if (r == 0 || errno != EINTR)
+            q->eof = 1;
+        pthread_cond_broadcast(&q->cond);
+        if (q->ready != NULL)
+            event_signal(q->ready);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return NULL;
+}
+
+// the bytes of a file or stdin
+datasource datasource_create_file(const char * _filename,
+                                  unsigned int _read_len,
+                                  event        _ready)
+{
+    int fd = strcmp(_filename, "-") == 0 ? STDIN_FILENO : open(_filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    datasource q = (datasource) malloc(sizeof(struct datasource_s));
+    q->fd     = fd;
+    q->map    = NULL;
+    q->size   = 0;
+    q->offset = 0;
+    q->state  = 1;
+    q->ring   = NULL;
+
+    // map regular files; pipes and terminals are read as they come
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void * map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            q->map  = (unsigned char*) map;
+            q->size = st.st_size;
+            return q;
+        }
+    }
+
+    // pipes and terminals are read ahead, a few reads' worth at least
+    q->capacity = 4*(size_t)_read_len > DATASOURCE_MIN_RING ? 4*(size_t)_read_len : DATASOURCE_MIN_RING;
+    q->ring     = (unsigned char*) malloc(q->capacity);
+    q->head     = 0;
+    q->count    = 0;
+    q->eof      = 0;
+    q->stopping = 0;
+    q->ready    = _ready;
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->cond, NULL);
+    pthread_create(&q->reader, NULL, datasource_reader, (void*)q);
+    return q;
+}
+
+// destroy source
+void datasource_destroy(datasource _q)
+{
+    if (_q->ring != NULL) {
+        // the reader may be blocked reading a quiet input
+        pthread_mutex_lock(&_q->mutex);
+        _q->stopping = 1;
+        pthread_cond_broadcast(&_q->cond);
+        pthread_mutex_unlock(&_q->mutex);
+        pthread_cancel(_q->reader);
+        pthread_join(_q->reader, NULL);
+        pthread_mutex_destroy(&_q->mutex);
+        pthread_cond_destroy(&_q->cond);
+        free(_q->ring);
+    }
+    if (_q->map != NULL)
+        munmap(_q->map, _q->size);
+    if (_q->fd > STDIN_FILENO)
+        close(_q->fd);
+    free(_q);
+}
+
+// can the next bytes be read without waiting?
+int datasource_ready(datasource _q, unsigned int _len)
+{
+    if (_q->ring == NULL)
+        return 1;
+    pthread_mutex_lock(&_q->mutex);
+    int ready = _q->count >= _len || _q->eof;
+    pthread_mutex_unlock(&_q->mutex);
+    return ready;
+}
+
+// take the next bytes
+unsigned int datasource_read(datasource             _q,
+                             unsigned char *        _buf,
+                             unsigned int           _len,
+                             const unsigned char ** _data)
+{
+    if (_q->map != NULL) {
+        size_t n = _q->size - _q->offset;
+        if (n > _len)
+            n = _len;
+        *_data = _q->map + _q->offset;
+        _q->offset += n;
+        return n;
+    }
+
+    *_data = _buf;
+    unsigned int n = 0;
+    if (_q->ring != NULL) {
+        // fill the whole payload unless the input ends
+        pthread_mutex_lock(&_q->mutex);
+        while (_q->count < _len && !_q->eof)
+            pthread_cond_wait(&_q->cond, &_q->mutex);
+        n = _q->count < _len ? _q->count : _len;
+        pthread_mutex_unlock(&_q->mutex);
+
+        // the reader never writes the buffered part, so it is copied
+        // out without the lock
+        size_t first = _q->capacity - _q->head < n ? _q->capacity - _q->head : n;
+        memcpy(_buf, _q->ring + _q->head, first);
+        memcpy(_buf + first, _q->ring, n - first);
+
+        pthread_mutex_lock(&_q->mutex);
+        _q->head   = (_q->head + n) % _q->capacity;
+        _q->count -= n;
+        pthread_cond_broadcast(&_q->cond);
+        pthread_mutex_unlock(&_q->mutex);
+        _q->offset += n;
+        return n;
+    }
+
+    unsigned long long x;
+    for (n=0; n + 8 <= _len; n += 8) {
+        x = datasource_next(_q);
+        memcpy(_buf + n, &x, 8);
+    }
+    if (n < _len) {
+        x = datasource_next(_q);
+        memcpy(_buf + n, &x, _len - n);
+    }
+    return _len;
+}
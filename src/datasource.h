@@ -0,0 +1,48 @@
+//
+// datasource
+//
+// Payload bytes for the base station to send. A file is memory-mapped
+// and handed out slice by slice straight from the mapping; the slices
+// outlive the frames, so they reach the radio, transmit queue included,
+// without a copy. Stdin and other unmappable inputs are read ahead into
+// a ring by a thread of their own, so a slow producer never blocks the
+// caller, and are copied out into the caller's buffer. Without an
+// input, a seeded xorshift generator fills the caller's buffer with
+// synthetic traffic 8 bytes at a time. The caller's buffer is reused,
+// so the transmit queue copies payloads from it once more.
+//
+
+#ifndef __DATASOURCE_H__
+#define __DATASOURCE_H__
+
+#include "event.h"
+
+typedef struct datasource_s * datasource;
+
+// endless pseudo-random bytes, the same sequence for the same seed
+datasource datasource_create_random(unsigned long long _seed);
+
+// the bytes of file _filename, or of stdin if it is "-", to be read
+// _read_len bytes at a time; _ready (unless NULL) is raised whenever
+// more input arrives. Returns NULL if the file cannot be opened.
+datasource datasource_create_file(const char * _filename,
+                                  unsigned int _read_len,
+                                  event        _ready);
+
+// destroy source, unmapping its file
+void datasource_destroy(datasource _q);
+
+// can the next _len bytes be read without waiting for the input?
+int datasource_ready(datasource _q, unsigned int _len);
+
+// take the next (up to) _len bytes and set *_data to them: either a
+// slice of the mapped file, valid and unchanged until the source is
+// destroyed, or _buf, which is filled. Waits for input unless
+// datasource_ready(). Returns the number of bytes, 0 once the input is
+// used up.
+unsigned int datasource_read(datasource             _q,
+                             unsigned char *        _buf,
+                             unsigned int           _len,
+                             const unsigned char ** _data);
+
+#endif // __DATASOURCE_H__
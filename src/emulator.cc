@@ -0,0 +1,460 @@
+//
+// emulator
+//
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include "emulator.h"
+
+// noise-only samples before and after each frame, in OFDM symbols, so
+// the synchronizer sees the frame start and flushes the frame end
+#define EMULATOR_GUARD_SYMBOLS 4
+
+// set channel properties to an unimpaired link
+void channel_props_init_default(channel_props_s * _props)
+{
+    _props->snr_dB     = 30.0f;
+    _props->fading_K   = -1.0f;
+    _props->cfo        = 0.0f;
+    _props->frame_loss = 0.0f;
+    _props->realtime   = 0;
+}
+
+emulated_transceiver::emulated_transceiver(unsigned int       _M,
+                                           unsigned int       _cp_len,
+                                           unsigned int       _taper_len,
+                                           unsigned char *    _p,
+                                           framesync_callback _callback,
+                                           void *             _userdata) :
+    M(_M),
+    cp_len(_cp_len),
+    taper_len(_taper_len),
+    tx_freq(0.0f),
+    tx_rate(500e3f),
+    tx_gain(1.0f),
+    realtime(false),
+    num_frames_sent(0),
+    num_frames_lost(0),
+    cache_bytes(0),
+    cache_budget(0),
+    num_frames_cached(0),
+    rx_freq(0.0f),
+    rx_running(false)
+{
+    if (_p != NULL)
+        p.assign(_p, _p + _M);
+    fs = ofdmflexframesync_create(_M, _cp_len, _taper_len, _p, _callback, _userdata);
+
+    pthread_mutex_init(&generator_mutex, NULL);
+    pthread_mutex_init(&cache_mutex, NULL);
+    pthread_mutex_init(&rx_mutex, NULL);
+    pthread_cond_init(&rx_cond, NULL);
+}
+
+emulated_transceiver::~emulated_transceiver()
+{
+    stop_rx();
+    unsigned int i;
+    for (i=0; i<generators.size(); i++) {
+        ofdmflexframegen_destroy(generators[i]->fg);
+        delete generators[i];
+    }
+    ofdmflexframesync_destroy(fs);
+    pthread_mutex_destroy(&generator_mutex);
+    pthread_mutex_destroy(&cache_mutex);
+    pthread_mutex_destroy(&rx_mutex);
+    pthread_cond_destroy(&rx_cond);
+}
+
+// also send our frames to _peer's receiver through a channel
+void emulated_transceiver::connect(emulated_transceiver * _peer,
+                                   channel_props_s *      _props,
+                                   unsigned int           _seed)
+{
+    link_s link;
+    link.peer      = _peer;
+    link.channel   = *_props;
+    link.rng.seed(_seed);
+    link.cfo_phase = 0.0f;
+    links.push_back(link);
+    realtime = realtime || _props->realtime;
+}
+
+void emulated_transceiver::set_tx_freq(float _tx_freq)           { tx_freq = _tx_freq; }
+void emulated_transceiver::set_tx_rate(float _tx_rate)           { tx_rate = _tx_rate; }
+void emulated_transceiver::set_tx_gain_soft(float _tx_gain_soft) { tx_gain = powf(10.0f, _tx_gain_soft/20.0f); }
+void emulated_transceiver::set_tx_gain_uhd(float _tx_gain_uhd)   { }
+
+void emulated_transceiver::set_rx_freq(float _rx_freq)           { rx_freq = _rx_freq; }
+void emulated_transceiver::set_rx_rate(float _rx_rate)           { }
+void emulated_transceiver::set_rx_gain_uhd(float _rx_gain_uhd)   { }
+
+// encode and modulate a frame, pass it through the channel and queue
+// it at the peer's receiver
+void emulated_transceiver::transmit_packet(unsigned char *   _header,
+                                           unsigned char *   _payload,
+                                           unsigned int      _payload_len,
+                                           modulation_scheme _mod,
+                                           fec_scheme        _fec0,
+                                           fec_scheme        _fec1)
+{
+    transmit_encoded(encode_packet(false, 0, _header, _payload, _payload_len, _mod, _fec0, _fec1));
+}
+
+void emulated_transceiver::transmit_cached_packet(unsigned long long _key,
+                                                  unsigned char *    _header,
+                                                  unsigned char *    _payload,
+                                                  unsigned int       _payload_len,
+                                                  modulation_scheme  _mod,
+                                                  fec_scheme         _fec0,
+                                                  fec_scheme         _fec1)
+{
+    transmit_encoded(encode_packet(true, _key, _header, _payload, _payload_len, _mod, _fec0, _fec1));
+}
+
+// encode and modulate a frame. A cached frame keeps its samples, and a
+// resend of the same payload at the same rate regenerates only the
+// symbols the header reaches and copies the payload symbols from the
+// cache.
+transceiver::encoded_frame * emulated_transceiver::encode_packet(bool               _cached,
+                                                                 unsigned long long _key,
+                                                                 unsigned char *    _header,
+                                                                 unsigned char *    _payload,
+                                                                 unsigned int       _payload_len,
+                                                                 modulation_scheme  _mod,
+                                                                 fec_scheme         _fec0,
+                                                                 fec_scheme         _fec1)
+{
+    emulated_frame * frame = new emulated_frame;
+    generator_s * gen = acquire_generator(_mod, _fec0, _fec1);
+
+    pthread_mutex_lock(&cache_mutex);
+    bool use_cache = _cached && cache_budget > 0;
+    pthread_mutex_unlock(&cache_mutex);
+    if (!use_cache) {
+        modulate(gen, _header, _payload, _payload_len, frame->samples);
+        release_generator(gen);
+        return frame;
+    }
+
+    // cached frames are never modified, only replaced or dropped, so
+    // the samples are read without the lock
+    std::shared_ptr<cached_frame_s> cached;
+    pthread_mutex_lock(&cache_mutex);
+    std::unordered_map<unsigned long long, std::shared_ptr<cached_frame_s> >::iterator it = cache.find(_key);
+    if (it != cache.end())
+        cached = it->second;
+    pthread_mutex_unlock(&cache_mutex);
+
+    std::vector<liquid_float_complex> & samples = frame->samples;
+    if (cached && cached->payload_len == _payload_len && cached->mod == _mod &&
+        cached->fec0 == _fec0 && cached->fec1 == _fec1)
+    {
+        unsigned int n = header_symbols(gen, _mod, _fec0, _fec1);
+        unsigned int i;
+        int last_symbol = 0;
+        ofdmflexframegen_reset(gen->fg);
+        ofdmflexframegen_assemble(gen->fg, _header, _payload, _payload_len);
+        for (i=0; i<n && !last_symbol; i++) {
+            last_symbol = ofdmflexframegen_writesymbol(gen->fg, &gen->buffer[0]);
+            samples.insert(samples.end(), gen->buffer.begin(), gen->buffer.end());
+        }
+        if (!last_symbol && samples.size() <= cached->samples.size()) {
+            samples.insert(samples.end(), cached->samples.begin() + samples.size(), cached->samples.end());
+            __atomic_add_fetch(&num_frames_cached, 1, __ATOMIC_RELAXED);
+        } else {
+            modulate(gen, _header, _payload, _payload_len, samples);
+        }
+        release_generator(gen);
+        return frame;
+    }
+
+    modulate(gen, _header, _payload, _payload_len, samples);
+    release_generator(gen);
+
+    std::shared_ptr<cached_frame_s> entry(new cached_frame_s);
+    entry->payload_len = _payload_len;
+    entry->mod         = _mod;
+    entry->fec0        = _fec0;
+    entry->fec1        = _fec1;
+    entry->samples     = samples;
+    size_t bytes = samples.size() * sizeof(liquid_float_complex);
+
+    // evict the oldest frames to make room
+    pthread_mutex_lock(&cache_mutex);
+    uncache(_key);
+    if (bytes <= cache_budget) {
+        while (cache_bytes + bytes > cache_budget)
+            uncache(cache_order.front());
+        entry->age = cache_order.insert(cache_order.end(), _key);
+        cache[_key] = entry;
+        cache_bytes += bytes;
+    }
+    pthread_mutex_unlock(&cache_mutex);
+    return frame;
+}
+
+// pass an encoded frame through the channels and free it
+void emulated_transceiver::transmit_encoded(encoded_frame * _frame)
+{
+    emulated_frame * frame = (emulated_frame*) _frame;
+    send(frame->samples);
+    delete frame;
+}
+
+// the frame sent under _key will not be sent again
+void emulated_transceiver::release_cached_packet(unsigned long long _key)
+{
+    pthread_mutex_lock(&cache_mutex);
+    uncache(_key);
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+// drop the frame cached under _key (cache_mutex must be held)
+void emulated_transceiver::uncache(unsigned long long _key)
+{
+    std::unordered_map<unsigned long long, std::shared_ptr<cached_frame_s> >::iterator it = cache.find(_key);
+    if (it == cache.end())
+        return;
+    cache_bytes -= it->second->samples.size() * sizeof(liquid_float_complex);
+    cache_order.erase(it->second->age);
+    cache.erase(it);
+}
+
+// keep up to _bytes of samples of frames that may be resent
+void emulated_transceiver::set_tx_cache(size_t _bytes)
+{
+    pthread_mutex_lock(&cache_mutex);
+    cache_budget = _bytes;
+    while (cache_bytes > cache_budget)
+        uncache(cache_order.front());
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+// take an idle generator set to the given rate
+emulated_transceiver::generator_s * emulated_transceiver::acquire_generator(modulation_scheme _mod,
+                                                                            fec_scheme        _fec0,
+                                                                            fec_scheme        _fec1)
+{
+    ofdmflexframegenprops_s fgprops;
+    ofdmflexframegenprops_init_default(&fgprops);
+    fgprops.mod_scheme = _mod;
+    fgprops.fec0       = _fec0;
+    fgprops.fec1       = _fec1;
+
+    generator_s * gen = NULL;
+    pthread_mutex_lock(&generator_mutex);
+    if (!generators.empty()) {
+        gen = generators.back();
+        generators.pop_back();
+    }
+    pthread_mutex_unlock(&generator_mutex);
+
+    if (gen == NULL) {
+        gen = new generator_s;
+        gen->fg = ofdmflexframegen_create(M, cp_len, taper_len, p.empty() ? NULL : &p[0], &fgprops);
+        gen->buffer.resize(M + cp_len);
+    }
+    ofdmflexframegen_setprops(gen->fg, &fgprops);
+    return gen;
+}
+
+// give an idle generator back
+void emulated_transceiver::release_generator(generator_s * _gen)
+{
+    pthread_mutex_lock(&generator_mutex);
+    generators.push_back(_gen);
+    pthread_mutex_unlock(&generator_mutex);
+}
+
+// modulate a whole frame, without guard samples
+void emulated_transceiver::modulate(generator_s *                       _gen,
+                                    unsigned char *                     _header,
+                                    unsigned char *                     _payload,
+                                    unsigned int                        _payload_len,
+                                    std::vector<liquid_float_complex> & _frame)
+{
+    ofdmflexframegen_reset(_gen->fg);
+    ofdmflexframegen_assemble(_gen->fg, _header, _payload, _payload_len);
+    _frame.clear();
+    int last_symbol = 0;
+    while (!last_symbol) {
+        last_symbol = ofdmflexframegen_writesymbol(_gen->fg, &_gen->buffer[0]);
+        _frame.insert(_frame.end(), _gen->buffer.begin(), _gen->buffer.end());
+    }
+}
+
+// number of leading symbols of a frame at _gen's rate that depend on
+// the header. It is found once per rate by modulating one payload
+// under two opposite headers: the frames differ from the first header
+// symbol through the first payload symbol, whose edge is tapered into
+// the last header symbol, and match again after that. (The final
+// symbols may differ as well when the generator pads them with random
+// data, but any padding is as good as any other.) Should the frames
+// never match again, the whole frame counts and nothing is reused.
+unsigned int emulated_transceiver::header_symbols(generator_s *     _gen,
+                                                  modulation_scheme _mod,
+                                                  fec_scheme        _fec0,
+                                                  fec_scheme        _fec1)
+{
+    unsigned int rate = (_mod << 16) | (_fec0 << 8) | _fec1;
+    pthread_mutex_lock(&cache_mutex);
+    std::map<unsigned int, unsigned int>::iterator it = num_header_symbols.find(rate);
+    bool known = it != num_header_symbols.end();
+    unsigned int n = known ? it->second : 0;
+    pthread_mutex_unlock(&cache_mutex);
+    if (known)
+        return n;
+
+    unsigned char header0[8];
+    unsigned char header1[8];
+    memset(header0, 0x00, 8);
+    memset(header1, 0xff, 8);
+    std::vector<unsigned char> payload(256, 0x00);
+    std::vector<liquid_float_complex> frame0;
+    std::vector<liquid_float_complex> frame1;
+    modulate(_gen, header0, &payload[0], payload.size(), frame0);
+    modulate(_gen, header1, &payload[0], payload.size(), frame1);
+
+    unsigned int symbol_len  = M + cp_len;
+    unsigned int num_symbols = frame0.size() / symbol_len;
+    size_t symbol_bytes = symbol_len * sizeof(liquid_float_complex);
+    while (n < num_symbols && memcmp(&frame0[n*symbol_len], &frame1[n*symbol_len], symbol_bytes) == 0)
+        n++;
+    while (n < num_symbols && memcmp(&frame0[n*symbol_len], &frame1[n*symbol_len], symbol_bytes) != 0)
+        n++;
+
+    pthread_mutex_lock(&cache_mutex);
+    num_header_symbols[rate] = n;
+    pthread_mutex_unlock(&cache_mutex);
+    return n;
+}
+
+// pass a modulated frame through the channel to each peer
+void emulated_transceiver::send(const std::vector<liquid_float_complex> & _frame)
+{
+    unsigned int symbol_len = M + cp_len;
+    unsigned int guard_len  = EMULATOR_GUARD_SYMBOLS*symbol_len;
+    std::vector<liquid_float_complex> samples(guard_len, 0.0f);
+    samples.insert(samples.end(), _frame.begin(), _frame.end());
+    samples.insert(samples.end(), guard_len, 0.0f);
+
+    unsigned int n = samples.size();
+    num_frames_sent++;
+
+    // the radio is busy for the frame's airtime even if it is lost
+    if (realtime && tx_rate > 0)
+        usleep((useconds_t)(1e6f * n / tx_rate));
+
+    // power of the frame as sent, for the noise level
+    unsigned int i;
+    float signal_power = 0.0f;
+    for (i=guard_len; i<n-guard_len; i++)
+        signal_power += std::norm(samples[i]);
+    signal_power /= (n - 2*guard_len);
+
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<liquid_float_complex> rx_samples;
+    unsigned int l;
+    for (l=0; l<links.size(); l++) {
+        link_s * link = &links[l];
+        if (uniform(link->rng) < link->channel.frame_loss) {
+            num_frames_lost++;
+            continue;
+        }
+
+        // block fading: one complex gain per frame
+        liquid_float_complex h = tx_gain;
+        if (link->channel.fading_K >= 0) {
+            float K    = link->channel.fading_K;
+            float los  = sqrtf(K / (K + 1.0f));
+            float nlos = sqrtf(0.5f / (K + 1.0f));
+            h *= liquid_float_complex(los + nlos*normal(link->rng), nlos*normal(link->rng));
+        }
+
+        // noise relative to the power of the frame as sent
+        float nstd = sqrtf(0.5f * signal_power * powf(10.0f, -link->channel.snr_dB/10.0f));
+
+        rx_samples.resize(n);
+        for (i=0; i<n; i++) {
+            rx_samples[i]  = samples[i] * h * std::polar(1.0f, link->cfo_phase);
+            rx_samples[i] += liquid_float_complex(nstd*normal(link->rng), nstd*normal(link->rng));
+            link->cfo_phase += link->channel.cfo;
+        }
+        link->cfo_phase = fmodf(link->cfo_phase, 2*M_PI);
+
+        link->peer->deliver(rx_samples, tx_freq);
+    }
+}
+
+// queue a received sample buffer for the receive thread; frames sent
+// on another frequency or while the receiver is off are never heard
+void emulated_transceiver::deliver(std::vector<liquid_float_complex> & _samples,
+                                   float                               _freq)
+{
+    pthread_mutex_lock(&rx_mutex);
+    if (rx_running && _freq == rx_freq) {
+        rx_queue.push_back(std::vector<liquid_float_complex>());
+        rx_queue.back().swap(_samples);
+        pthread_cond_signal(&rx_cond);
+    }
+    pthread_mutex_unlock(&rx_mutex);
+}
+
+void * emulated_transceiver::rx_thread(void * _arg)
+{
+    emulated_transceiver * q = (emulated_transceiver*) _arg;
+    std::vector<liquid_float_complex> samples;
+
+    pthread_mutex_lock(&q->rx_mutex);
+    while (q->rx_running) {
+        if (q->rx_queue.empty()) {
+            pthread_cond_wait(&q->rx_cond, &q->rx_mutex);
+            continue;
+        }
+        samples.swap(q->rx_queue.front());
+        q->rx_queue.pop_front();
+
+        // run the synchronizer (and so the callback) without the lock
+        pthread_mutex_unlock(&q->rx_mutex);
+        ofdmflexframesync_execute(q->fs, &samples[0], samples.size());
+        pthread_mutex_lock(&q->rx_mutex);
+    }
+    pthread_mutex_unlock(&q->rx_mutex);
+    return NULL;
+}
+
+void emulated_transceiver::start_rx()
+{
+    pthread_mutex_lock(&rx_mutex);
+    if (rx_running) {
+        pthread_mutex_unlock(&rx_mutex);
+        return;
+    }
+    rx_running = true;
+    pthread_mutex_unlock(&rx_mutex);
+
+    ofdmflexframesync_reset(fs);
+    pthread_create(&rx_process, NULL, rx_thread, (void*)this);
+}
+
+void emulated_transceiver::stop_rx()
+{
+    pthread_mutex_lock(&rx_mutex);
+    if (!rx_running) {
+        pthread_mutex_unlock(&rx_mutex);
+        return;
+    }
+    rx_running = false;
+    rx_queue.clear();
+    pthread_cond_signal(&rx_cond);
+    pthread_mutex_unlock(&rx_mutex);
+
+    pthread_join(rx_process, NULL);
+}
+
+unsigned int emulated_transceiver::get_num_frames_sent() { return num_frames_sent; }
+unsigned int emulated_transceiver::get_num_frames_lost() { return num_frames_lost; }
+unsigned int emulated_transceiver::get_num_frames_cached() { return __atomic_load_n(&num_frames_cached, __ATOMIC_RELAXED); }
@@ -0,0 +1,206 @@
+//
+// emulator
+//
+// In-process software channel standing in for a pair of USRPs. Each
+// emulated_transceiver modulates frames with liquid's ofdmflexframegen,
+// passes the samples through the channel configured for the link to
+// its peer (block fading, carrier offset, AWGN, whole-frame loss) and
+// hands them to the peer's ofdmflexframesync on the peer's receive
+// thread. A transceiver may be connected to several peers (a base
+// station and its UAVs); every peer hears every frame through its own
+// channel. Frames are delivered whole and never collide. Unless paced,
+// frames move as fast as the CPU allows, so ARQ and PHY throughput can
+// be measured faster than real time. Frames sent with
+// transmit_cached_packet() are kept, up to a memory budget, so a
+// retransmission re-encodes only its header symbols and reuses the
+// payload symbols of the first copy.
+//
+
+#ifndef __EMULATOR_H__
+#define __EMULATOR_H__
+
+#include <pthread.h>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <random>
+#include "transceiver.h"
+
+struct channel_props_s {
+    float snr_dB;           // signal-to-noise ratio [dB]
+    float fading_K;         // Rician K-factor of per-frame block fading,
+                            // negative for no fading
+    float cfo;              // carrier frequency offset [radians/sample]
+    float frame_loss;       // probability a frame never arrives
+    int realtime;           // pace frames at the transmit sample rate
+};
+
+// set channel properties to an unimpaired link
+void channel_props_init_default(channel_props_s * _props);
+
+class emulated_transceiver : public transceiver {
+public:
+    emulated_transceiver(unsigned int       _M,
+                         unsigned int       _cp_len,
+                         unsigned int       _taper_len,
+                         unsigned char *    _p,
+                         framesync_callback _callback,
+                         void *             _userdata);
+    ~emulated_transceiver();
+
+    // also send our frames to _peer's receiver, through a channel with
+    // the given properties; _seed fixes the channel's random draws
+    void connect(emulated_transceiver * _peer,
+                 channel_props_s *      _props,
+                 unsigned int           _seed);
+
+    void set_tx_freq(float _tx_freq);
+    void set_tx_rate(float _tx_rate);
+    void set_tx_gain_soft(float _tx_gain_soft);
+    void set_tx_gain_uhd(float _tx_gain_uhd);
+
+    void transmit_packet(unsigned char *   _header,
+                         unsigned char *   _payload,
+                         unsigned int      _payload_len,
+                         modulation_scheme _mod,
+                         fec_scheme        _fec0,
+                         fec_scheme        _fec1);
+
+    void transmit_cached_packet(unsigned long long _key,
+                                unsigned char *    _header,
+                                unsigned char *    _payload,
+                                unsigned int       _payload_len,
+                                modulation_scheme  _mod,
+                                fec_scheme         _fec0,
+                                fec_scheme         _fec1);
+    void release_cached_packet(unsigned long long _key);
+
+    // frames may be encoded on several threads at once
+    encoded_frame * encode_packet(bool               _cached,
+                                  unsigned long long _key,
+                                  unsigned char *    _header,
+                                  unsigned char *    _payload,
+                                  unsigned int       _payload_len,
+                                  modulation_scheme  _mod,
+                                  fec_scheme         _fec0,
+                                  fec_scheme         _fec1);
+    void transmit_encoded(encoded_frame * _frame);
+
+    // keep up to _bytes of samples of frames that may be resent; 0
+    // (the default) disables the cache
+    void set_tx_cache(size_t _bytes);
+
+    void set_rx_freq(float _rx_freq);
+    void set_rx_rate(float _rx_rate);
+    void set_rx_gain_uhd(float _rx_gain_uhd);
+
+    void start_rx();
+    void stop_rx();
+
+    // frames transmitted, and copies dropped by the channels
+    unsigned int get_num_frames_sent();
+    unsigned int get_num_frames_lost();
+
+    // retransmissions that reused cached payload symbols
+    unsigned int get_num_frames_cached();
+
+private:
+    // frame generator with a buffer for one symbol
+    struct generator_s {
+        ofdmflexframegen fg;
+        std::vector<liquid_float_complex> buffer;
+    };
+
+    // modulated frame, without guard samples
+    struct emulated_frame : encoded_frame {
+        std::vector<liquid_float_complex> samples;
+    };
+
+    // take an idle generator (creating one if there is none) set to
+    // the given rate, and give it back
+    generator_s * acquire_generator(modulation_scheme _mod,
+                                    fec_scheme        _fec0,
+                                    fec_scheme        _fec1);
+    void release_generator(generator_s * _gen);
+
+    // modulate a whole frame
+    void modulate(generator_s *                       _gen,
+                  unsigned char *                     _header,
+                  unsigned char *                     _payload,
+                  unsigned int                        _payload_len,
+                  std::vector<liquid_float_complex> & _frame);
+
+    // number of leading symbols of a frame at _gen's rate that depend
+    // on the header
+    unsigned int header_symbols(generator_s *     _gen,
+                                modulation_scheme _mod,
+                                fec_scheme        _fec0,
+                                fec_scheme        _fec1);
+
+    // pass a modulated frame through the channels
+    void send(const std::vector<liquid_float_complex> & _frame);
+
+    // drop the frame cached under _key (cache_mutex must be held)
+    void uncache(unsigned long long _key);
+
+    // queue a received sample buffer for the receive thread
+    void deliver(std::vector<liquid_float_complex> & _samples, float _freq);
+
+    static void * rx_thread(void * _arg);
+
+    unsigned int M;
+    unsigned int cp_len;
+    unsigned int taper_len;
+    std::vector<unsigned char> p;   // subcarrier allocation, empty for
+                                    // liquid's default
+
+    // transmitter; one generator per thread encoding at the time
+    std::vector<generator_s*> generators;
+    pthread_mutex_t generator_mutex;
+    float tx_freq;
+    float tx_rate;
+    float tx_gain;
+
+    // channel to each peer
+    struct link_s {
+        emulated_transceiver * peer;
+        channel_props_s channel;
+        std::mt19937 rng;
+        float cfo_phase;
+    };
+    std::vector<link_s> links;
+    bool realtime;
+    unsigned int num_frames_sent;
+    unsigned int num_frames_lost;
+
+    // frames that may be resent, by key, and their keys oldest first
+    struct cached_frame_s {
+        unsigned int payload_len;
+        modulation_scheme mod;
+        fec_scheme fec0;
+        fec_scheme fec1;
+        std::vector<liquid_float_complex> samples;
+        std::list<unsigned long long>::iterator age;
+    };
+    std::unordered_map<unsigned long long, std::shared_ptr<cached_frame_s> > cache;
+    std::list<unsigned long long> cache_order;
+    size_t cache_bytes;
+    size_t cache_budget;
+    std::map<unsigned int, unsigned int> num_header_symbols;   // by rate
+    unsigned int num_frames_cached;
+    pthread_mutex_t cache_mutex;
+
+    // receiver
+    ofdmflexframesync fs;
+    float rx_freq;
+    std::deque<std::vector<liquid_float_complex> > rx_queue;
+    pthread_mutex_t rx_mutex;
+    pthread_cond_t rx_cond;
+    pthread_t rx_process;
+    bool rx_running;
+};
+
+#endif // __EMULATOR_H__
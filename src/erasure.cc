@@ -0,0 +1,441 @@
+//
+// erasure
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "frameheader.h"
+#include "erasure.h"
+
+// blocks a decoder collects repair frames for at once
+#define ERASURE_MAX_BLOCKS 8
+
+// GF(2^8) with the polynomial x^8+x^4+x^3+x^2+1: full product table so
+// coding a byte is one lookup
+static unsigned char gf_mul[256][256];
+static unsigned char gf_inv[256];
+static pthread_once_t gf_once = PTHREAD_ONCE_INIT;
+
+static void gf_init()
+{
+    unsigned char exp[255];
+    unsigned char log[256];
+    unsigned int x = 1;
+    unsigned int i;
+    for (i=0; i<255; i++) {
+        exp[i] = x;
+        log[x] = i;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= 0x11d;
+    }
+    unsigned int a, b;
+    for (a=0; a<256; a++) {
+        for (b=0; b<256; b++)
+            gf_mul[a][b] = (a == 0 || b == 0) ? 0 : exp[(log[a] + log[b]) % 255];
+        gf_inv[a] = a == 0 ? 0 : exp[(255 - log[a]) % 255];
+    }
+}
+
+// coefficient of payload _i in repair frame _r: the Cauchy matrix
+// 1/(x_r + y_i) with x_r = 128+r and y_i = i, every square submatrix of
+// which is invertible
+static unsigned char erasure_coef(unsigned int _r, unsigned int _i)
+{
+    return gf_inv[(128 + _r) ^ _i];
+}
+
+// _dst += _c * _src
+static void gf_mul_add(unsigned char *       _dst,
+                       const unsigned char * _src,
+                       unsigned char         _c,
+                       unsigned int          _len)
+{
+    unsigned int i;
+    if (_c == 1) {
+        for (i=0; i<_len; i++)
+            _dst[i] ^= _src[i];
+        return;
+    }
+    const unsigned char * t = gf_mul[_c];
+    for (i=0; i<_len; i++)
+        _dst[i] ^= t[_src[i]];
+}
+
+// _buf *= _c
+static void gf_scale(unsigned char * _buf, unsigned char _c, unsigned int _len)
+{
+    const unsigned char * t = gf_mul[_c];
+    unsigned int i;
+    for (i=0; i<_len; i++)
+        _buf[i] = t[_buf[i]];
+}
+
+// _dst += _c * (length prefix + payload), the coded form of a payload
+static void erasure_mul_add_payload(unsigned char *       _dst,
+                                    const unsigned char * _payload,
+                                    unsigned int          _payload_len,
+                                    unsigned char         _c)
+{
+    unsigned char prefix[2] = { (unsigned char)(_payload_len >> 8), (unsigned char)_payload_len };
+    gf_mul_add(_dst, prefix, _c, 2);
+    gf_mul_add(_dst + 2, _payload, _c, _payload_len);
+}
+
+//
+// encoder
+//
+
+struct erasure_encoder_s {
+    unsigned int k;
+    unsigned int r;
+    unsigned int max_len;           // longest coded payload, prefix included
+    unsigned char * repairs;        // r rows of max_len bytes
+    unsigned int size;              // payloads in the block
+    unsigned int len;               // longest coded payload in the block
+};
+
+// create encoder
+erasure_encoder erasure_encoder_create(unsigned int _k,
+                                       unsigned int _r,
+                                       unsigned int _max_len)
+{
+    pthread_once(&gf_once, gf_init);
+    erasure_encoder q = (erasure_encoder) malloc(sizeof(struct erasure_encoder_s));
+    q->k       = _k < 1 ? 1 : _k > ERASURE_MAX_K ? ERASURE_MAX_K : _k;
+    q->r       = _r < 1 ? 1 : _r > ERASURE_MAX_R ? ERASURE_MAX_R : _r;
+    q->max_len = _max_len + 2;
+    q->repairs = (unsigned char*) calloc(q->r, q->max_len);
+    q->size    = 0;
+    q->len     = 0;
+    return q;
+}
+
+// destroy encoder
+void erasure_encoder_destroy(erasure_encoder _q)
+{
+    free(_q->repairs);
+    free(_q);
+}
+
+// fold the next payload into every repair row
+unsigned int erasure_encoder_add(erasure_encoder       _q,
+                                 const unsigned char * _payload,
+                                 unsigned int          _payload_len)
+{
+    if (_q->size == _q->k || _payload_len + 2 > _q->max_len)
+        return _q->size;
+    unsigned int r;
+    for (r=0; r<_q->r; r++)
+        erasure_mul_add_payload(_q->repairs + r*_q->max_len, _payload, _payload_len, erasure_coef(r, _q->size));
+    if (_payload_len + 2 > _q->len)
+        _q->len = _payload_len + 2;
+    return ++_q->size;
+}
+
+// number of payloads in the block
+unsigned int erasure_encoder_size(erasure_encoder _q)
+{
+    return _q->size;
+}
+
+// write repair frame
+unsigned int erasure_encoder_repair(erasure_encoder _q,
+                                    unsigned int    _index,
+                                    unsigned char * _payload)
+{
+    _payload[0] = _q->size;
+    memcpy(_payload + 1, _q->repairs + (_index % _q->r)*_q->max_len, _q->len);
+    return _q->len + 1;
+}
+
+// start a new block
+void erasure_encoder_reset(erasure_encoder _q)
+{
+    unsigned int r;
+    for (r=0; r<_q->r; r++)
+        memset(_q->repairs + r*_q->max_len, 0x00, _q->len);
+    _q->size = 0;
+    _q->len  = 0;
+}
+
+//
+// decoder
+//
+
+struct erasure_slot_s {
+    unsigned char * data;           // payload copy, grown as needed
+    unsigned int size;              // bytes allocated
+    unsigned int len;               // payload bytes
+    unsigned int id;
+    int present;
+};
+
+struct erasure_block_s {
+    int used;
+    unsigned int first;             // id of the block's first packet
+    unsigned int n;                 // packets in the block
+    unsigned int len;               // coded bytes per repair frame
+    unsigned int stamp;             // when last added to, for eviction
+    unsigned int num_repairs;
+    unsigned char index[ERASURE_MAX_R];     // repair index of each row
+    unsigned char * repairs[ERASURE_MAX_R]; // coded bytes, grown as needed
+    unsigned int size[ERASURE_MAX_R];       // bytes allocated per row
+};
+
+struct erasure_decoder_s {
+    erasure_slot_s * slots;         // data payloads by id modulo capacity
+    unsigned int capacity;          // power of two
+    erasure_block_s blocks[ERASURE_MAX_BLOCKS];
+    unsigned int stamp;
+
+    // recovered ids of the last call, and scratch space for decoding
+    unsigned int recovered[ERASURE_MAX_K];
+    unsigned int num_recovered;
+    unsigned char * rows;
+    unsigned int rows_size;
+};
+
+// create decoder
+erasure_decoder erasure_decoder_create(unsigned int _window)
+{
+    pthread_once(&gf_once, gf_init);
+    unsigned int capacity = ERASURE_MAX_K;
+    while (capacity < _window && capacity < (1u << 30))
+        capacity <<= 1;
+
+    erasure_decoder q = (erasure_decoder) malloc(sizeof(struct erasure_decoder_s));
+    q->slots         = (erasure_slot_s*) calloc(capacity, sizeof(erasure_slot_s));
+    q->capacity      = capacity;
+    memset(q->blocks, 0x00, sizeof(q->blocks));
+    q->stamp         = 0;
+    q->num_recovered = 0;
+    q->rows          = NULL;
+    q->rows_size     = 0;
+    return q;
+}
+
+// destroy decoder
+void erasure_decoder_destroy(erasure_decoder _q)
+{
+    unsigned int i, r;
+    for (i=0; i<_q->capacity; i++)
+        free(_q->slots[i].data);
+    for (i=0; i<ERASURE_MAX_BLOCKS; i++) {
+        for (r=0; r<ERASURE_MAX_R; r++)
+            free(_q->blocks[i].repairs[r]);
+    }
+    free(_q->slots);
+    free(_q->rows);
+    free(_q);
+}
+
+// copy of packet _id, or NULL if it is not held
+static erasure_slot_s * erasure_decoder_slot(erasure_decoder _q, unsigned int _id)
+{
+    erasure_slot_s * slot = &_q->slots[_id & (_q->capacity - 1)];
+    return slot->present && slot->id == _id ? slot : NULL;
+}
+
+// keep a copy of packet _id
+static void erasure_decoder_store(erasure_decoder       _q,
+                                  unsigned int          _id,
+                                  const unsigned char * _payload,
+                                  unsigned int          _payload_len)
+{
+    erasure_slot_s * slot = &_q->slots[_id & (_q->capacity - 1)];
+    if (slot->size < _payload_len) {
+        slot->data = (unsigned char*) realloc(slot->data, _payload_len);
+        slot->size = _payload_len;
+    }
+    memcpy(slot->data, _payload, _payload_len);
+    slot->len     = _payload_len;
+    slot->id      = _id;
+    slot->present = 1;
+}
+
+// solve block _b for its missing packets if it has enough repair
+// frames, dropping it once nothing is missing
+static void erasure_decoder_solve(erasure_decoder _q, erasure_block_s * _b)
+{
+    unsigned int missing[ERASURE_MAX_K];
+    unsigned int m = 0;
+    unsigned int i, j, k;
+    for (i=0; i<_b->n; i++) {
+        erasure_slot_s * slot = &_q->slots[(_b->first + i) & (_q->capacity - 1)];
+        if (slot->present && frameheader_seq_diff(slot->id, _b->first + i) > 0) {
+            // the window has moved past the block
+            _b->used = 0;
+            return;
+        }
+        if (erasure_decoder_slot(_q, _b->first + i) == NULL)
+            missing[m++] = i;
+    }
+    if (m == 0) {
+        _b->used = 0;
+        return;
+    }
+    if (m > _b->num_repairs)
+        return;
+
+    // take the known payloads out of m repair frames, leaving m
+    // combinations of the missing ones
+    unsigned int len = _b->len;
+    if (_q->rows_size < m*len) {
+        _q->rows = (unsigned char*) realloc(_q->rows, m*len);
+        _q->rows_size = m*len;
+    }
+    unsigned char * row[ERASURE_MAX_K];
+    unsigned char a[ERASURE_MAX_K][ERASURE_MAX_K];
+    for (j=0; j<m; j++) {
+        row[j] = _q->rows + j*len;
+        memcpy(row[j], _b->repairs[j], len);
+        for (i=0, k=0; i<_b->n; i++) {
+            if (k < m && missing[k] == i) {
+                a[j][k++] = erasure_coef(_b->index[j], i);
+                continue;
+            }
+            erasure_slot_s * slot = erasure_decoder_slot(_q, _b->first + i);
+            if (slot->len + 2 > len) {
+                // not the payload this block was coded from
+                _b->used = 0;
+                return;
+            }
+            erasure_mul_add_payload(row[j], slot->data, slot->len, erasure_coef(_b->index[j], i));
+        }
+    }
+
+    // Gauss-Jordan elimination on the m x m Cauchy submatrix, applying
+    // the same row operations to the coded bytes
+    unsigned char * t;
+    unsigned char c;
+    for (k=0; k<m; k++) {
+        for (j=k; j<m && a[j][k] == 0; j++);
+        if (j == m) {
+            _b->used = 0;
+            return;
+        }
+        if (j != k) {
+            for (i=0; i<m; i++) {
+                c = a[j][i]; a[j][i] = a[k][i]; a[k][i] = c;
+            }
+            t = row[j]; row[j] = row[k]; row[k] = t;
+        }
+        c = gf_inv[a[k][k]];
+        for (i=0; i<m; i++)
+            a[k][i] = gf_mul[c][a[k][i]];
+        gf_scale(row[k], c, len);
+        for (j=0; j<m; j++) {
+            if (j == k || a[j][k] == 0)
+                continue;
+            c = a[j][k];
+            for (i=0; i<m; i++)
+                a[j][i] ^= gf_mul[c][a[k][i]];
+            gf_mul_add(row[j], row[k], c, len);
+        }
+    }
+
+    // row k now holds missing packet k with its length prefix
+    for (k=0; k<m; k++) {
+        unsigned int n = (row[k][0] << 8) | row[k][1];
+        if (n + 2 > len)
+            continue;
+        erasure_decoder_store(_q, _b->first + missing[k], row[k] + 2, n);
+        _q->recovered[_q->num_recovered++] = _b->first + missing[k];
+    }
+    _b->used = 0;
+}
+
+// data packet arrived
+unsigned int erasure_decoder_add_data(erasure_decoder       _q,
+                                      unsigned int          _id,
+                                      const unsigned char * _payload,
+                                      unsigned int          _payload_len)
+{
+    _q->num_recovered = 0;
+    if (erasure_decoder_slot(_q, _id) != NULL)
+        return 0;
+    erasure_decoder_store(_q, _id, _payload, _payload_len);
+
+    // it may be the piece a block with repairs was waiting for
+    unsigned int i;
+    for (i=0; i<ERASURE_MAX_BLOCKS; i++) {
+        erasure_block_s * b = &_q->blocks[i];
+        int d = frameheader_seq_diff(_id, b->first);
+        if (b->used && d >= 0 && (unsigned int)d < b->n) {
+            erasure_decoder_solve(_q, b);
+            break;
+        }
+    }
+    return _q->num_recovered;
+}
+
+// repair frame arrived
+unsigned int erasure_decoder_add_repair(erasure_decoder       _q,
+                                        unsigned int          _first,
+                                        unsigned int          _index,
+                                        const unsigned char * _payload,
+                                        unsigned int          _payload_len)
+{
+    _q->num_recovered = 0;
+    if (_payload_len < ERASURE_OVERHEAD || _payload[0] == 0 || _payload[0] > ERASURE_MAX_K ||
+        _index >= ERASURE_MAX_R)
+        return 0;
+    unsigned int n = _payload[0];
+    unsigned int len = _payload_len - 1;
+
+    // find the block, else take a free entry or the stalest one
+    erasure_block_s * b = NULL;
+    erasure_block_s * victim = &_q->blocks[0];
+    unsigned int i;
+    for (i=0; i<ERASURE_MAX_BLOCKS; i++) {
+        erasure_block_s * e = &_q->blocks[i];
+        if (e->used && e->first == _first && e->n == n && e->len == len) {
+            b = e;
+            break;
+        }
+        if (victim->used && (!e->used || _q->stamp - e->stamp > _q->stamp - victim->stamp))
+            victim = e;
+    }
+    if (b == NULL) {
+        b = victim;
+        b->used        = 1;
+        b->first       = _first;
+        b->n           = n;
+        b->len         = len;
+        b->num_repairs = 0;
+    }
+    b->stamp = ++_q->stamp;
+
+    // more than the block could ever need are of no use
+    for (i=0; i<b->num_repairs; i++) {
+        if (b->index[i] == _index)
+            return 0;
+    }
+    if (b->num_repairs == n)
+        return 0;
+    unsigned int r = b->num_repairs++;
+    if (b->size[r] < len) {
+        b->repairs[r] = (unsigned char*) realloc(b->repairs[r], len);
+        b->size[r] = len;
+    }
+    memcpy(b->repairs[r], _payload + 1, len);
+    b->index[r] = _index;
+
+    erasure_decoder_solve(_q, b);
+    return _q->num_recovered;
+}
+
+// get recovered packet
+void erasure_decoder_get(erasure_decoder        _q,
+                         unsigned int           _i,
+                         unsigned int *         _id,
+                         const unsigned char ** _payload,
+                         unsigned int *         _payload_len)
+{
+    erasure_slot_s * slot = erasure_decoder_slot(_q, _q->recovered[_i]);
+    *_id          = _q->recovered[_i];
+    *_payload     = slot->data;
+    *_payload_len = slot->len;
+}
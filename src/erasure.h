@@ -0,0 +1,91 @@
+//
+// erasure
+//
+// Packet-level erasure code across blocks of data frames. The base
+// station feeds up to K consecutive data payloads of a session into an
+// encoder and then sends R repair frames, each a different linear
+// combination of the block's payloads over GF(2^8) (a systematic Cauchy
+// Reed-Solomon code). The UAV keeps its recent payloads and rebuilds any
+// m missing ones of a block from any m of its repair frames, without
+// waiting for a retransmission. Payloads may differ in length: each is
+// coded with a 2-byte length prefix and zero padding up to the longest
+// one in the block.
+//
+// A repair frame carries the id of the block's first packet in its
+// header sequence number and its repair index in the info byte; its
+// payload is one byte giving the number of packets in the block followed
+// by the coded bytes.
+//
+
+#ifndef __ERASURE_H__
+#define __ERASURE_H__
+
+// largest block and number of repair frames per block
+#define ERASURE_MAX_K 128
+#define ERASURE_MAX_R 128
+
+// bytes a repair frame adds to the longest payload of its block
+#define ERASURE_OVERHEAD 3
+
+typedef struct erasure_encoder_s * erasure_encoder;
+
+// create encoder for blocks of up to _k payloads of up to _max_len
+// bytes, with _r repair frames per block
+erasure_encoder erasure_encoder_create(unsigned int _k,
+                                       unsigned int _r,
+                                       unsigned int _max_len);
+
+// destroy encoder
+void erasure_encoder_destroy(erasure_encoder _q);
+
+// add the next payload of the block; returns the number of payloads in
+// the block so far
+unsigned int erasure_encoder_add(erasure_encoder       _q,
+                                 const unsigned char * _payload,
+                                 unsigned int          _payload_len);
+
+// number of payloads in the block
+unsigned int erasure_encoder_size(erasure_encoder _q);
+
+// write repair frame _index of the block to _payload, which must hold
+// _max_len + ERASURE_OVERHEAD bytes; returns its length
+unsigned int erasure_encoder_repair(erasure_encoder _q,
+                                    unsigned int    _index,
+                                    unsigned char * _payload);
+
+// start a new block
+void erasure_encoder_reset(erasure_encoder _q);
+
+typedef struct erasure_decoder_s * erasure_decoder;
+
+// create decoder keeping copies of the last _window data payloads
+// (rounded up to a power of two) to rebuild lost ones with
+erasure_decoder erasure_decoder_create(unsigned int _window);
+
+// destroy decoder
+void erasure_decoder_destroy(erasure_decoder _q);
+
+// data packet _id arrived intact; returns the number of packets of its
+// block this made recoverable, see erasure_decoder_get()
+unsigned int erasure_decoder_add_data(erasure_decoder       _q,
+                                      unsigned int          _id,
+                                      const unsigned char * _payload,
+                                      unsigned int          _payload_len);
+
+// repair frame _index of the block starting at packet _first arrived
+// intact; returns the number of packets recovered
+unsigned int erasure_decoder_add_repair(erasure_decoder       _q,
+                                        unsigned int          _first,
+                                        unsigned int          _index,
+                                        const unsigned char * _payload,
+                                        unsigned int          _payload_len);
+
+// get recovered packet _i of the last call to add (valid until the next
+// one)
+void erasure_decoder_get(erasure_decoder        _q,
+                         unsigned int           _i,
+                         unsigned int *         _id,
+                         const unsigned char ** _payload,
+                         unsigned int *         _payload_len);
+
+#endif // __ERASURE_H__
@@ -0,0 +1,74 @@
+//
+// event
+//
+
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "event.h"
+
+struct event_s {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int pending;
+};
+
+// create event object
+event event_create()
+{
+    event q = (event) malloc(sizeof(struct event_s));
+    q->pending = 0;
+
+    // time out against the monotonic clock so wall-clock steps do not
+    // stretch or cut short a wait
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&q->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&q->mutex, NULL);
+
+    return q;
+}
+
+// destroy event object
+void event_destroy(event _q)
+{
+    pthread_cond_destroy(&_q->cond);
+    pthread_mutex_destroy(&_q->mutex);
+    free(_q);
+}
+
+// raise the event, waking the waiting thread
+void event_signal(event _q)
+{
+    pthread_mutex_lock(&_q->mutex);
+    _q->pending = 1;
+    pthread_cond_signal(&_q->cond);
+    pthread_mutex_unlock(&_q->mutex);
+}
+
+// wait until the event is raised or _timeout seconds pass
+int event_wait(event _q, float _timeout)
+{
+    pthread_mutex_lock(&_q->mutex);
+    if (_timeout < 0) {
+        while (!_q->pending)
+            pthread_cond_wait(&_q->cond, &_q->mutex);
+    } else if (!_q->pending) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        long long ns = ts.tv_nsec + (long long)(_timeout * 1e9f);
+        ts.tv_sec  += ns / 1000000000LL;
+        ts.tv_nsec  = ns % 1000000000LL;
+
+        int rc = 0;
+        while (!_q->pending && rc != ETIMEDOUT)
+            rc = pthread_cond_timedwait(&_q->cond, &_q->mutex, &ts);
+    }
+    int raised = _q->pending;
+    _q->pending = 0;
+    pthread_mutex_unlock(&_q->mutex);
+    return raised;
+}
@@ -0,0 +1,27 @@
+//
+// event
+//
+// Wakeup flag shared between the RX callback thread and a main loop.
+// A signal raised while nobody is waiting is latched, so it is never
+// lost; the next wait returns straight away and clears it.
+//
+
+#ifndef __EVENT_H__
+#define __EVENT_H__
+
+typedef struct event_s * event;
+
+// create event object
+event event_create();
+
+// destroy event object
+void event_destroy(event _q);
+
+// raise the event, waking the waiting thread
+void event_signal(event _q);
+
+// wait until the event is raised or _timeout seconds pass (wait
+// forever if _timeout < 0); returns 1 if the event was raised
+int event_wait(event _q, float _timeout);
+
+#endif // __EVENT_H__
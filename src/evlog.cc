@@ -0,0 +1,217 @@
+//
+// evlog
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "timer.h"
+#include "event.h"
+#include "evlog.h"
+
+// records per thread ring (power of two)
+#define EVLOG_RING_LEN      4096
+
+// maximum number of threads writing to one log
+#define EVLOG_MAX_THREADS   16
+
+// how often the writer drains the rings [seconds]
+#define EVLOG_DRAIN_PERIOD  0.1f
+
+// single-producer/single-consumer ring owned by one writing thread
+struct evlog_ring_s {
+    alignas(64) unsigned int head;      // advanced by the writer thread
+    alignas(64) unsigned int tail;      // advanced by the owning thread
+    pthread_t owner;
+    evlog_record_s records[EVLOG_RING_LEN];
+};
+
+struct evlog_s {
+    FILE * fid;
+    evlog_ring_s * rings[EVLOG_MAX_THREADS];
+    unsigned int num_rings;
+    pthread_mutex_t rings_mutex;        // taken only to add a ring
+    unsigned int num_dropped;
+
+    pthread_t writer;
+    event wakeup;
+    int running;
+    unsigned int serial;                // tells apart logs at a reused address
+};
+
+// per-thread cache of the ring used for each log
+struct evlog_cache_s {
+    evlog log;
+    unsigned int serial;
+    evlog_ring_s * ring;
+};
+static thread_local evlog_cache_s evlog_cache[4];
+static unsigned int evlog_num_created = 0;
+
+// find (or create) the calling thread's ring
+static evlog_ring_s * evlog_get_ring(evlog _q)
+{
+    unsigned int i;
+    for (i=0; i<4; i++) {
+        if (evlog_cache[i].log == _q && evlog_cache[i].serial == _q->serial)
+            return evlog_cache[i].ring;
+    }
+
+    // first record from this thread: register a ring
+    evlog_ring_s * ring = NULL;
+    pthread_mutex_lock(&_q->rings_mutex);
+    for (i=0; i<_q->num_rings; i++) {
+        if (pthread_equal(_q->rings[i]->owner, pthread_self()))
+            ring = _q->rings[i];
+    }
+    if (ring == NULL && _q->num_rings < EVLOG_MAX_THREADS) {
+        ring = new evlog_ring_s;
+        ring->head  = 0;
+        ring->tail  = 0;
+        ring->owner = pthread_self();
+        __atomic_store_n(&_q->rings[_q->num_rings], ring, __ATOMIC_RELEASE);
+        __atomic_store_n(&_q->num_rings, _q->num_rings+1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&_q->rings_mutex);
+
+    if (ring != NULL) {
+        for (i=0; i<4 && evlog_cache[i].log != NULL; i++);
+        if (i == 4)
+            i = 0;
+        evlog_cache[i].log    = _q;
+        evlog_cache[i].serial = _q->serial;
+        evlog_cache[i].ring   = ring;
+    }
+    return ring;
+}
+
+// write every queued record to the file
+static void evlog_drain(evlog _q)
+{
+    unsigned int num_rings = __atomic_load_n(&_q->num_rings, __ATOMIC_ACQUIRE);
+    unsigned int i;
+    for (i=0; i<num_rings; i++) {
+        evlog_ring_s * ring = _q->rings[i];
+        unsigned int head = ring->head;
+        unsigned int tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            // write the contiguous run up to the end of the ring
+            unsigned int k = head & (EVLOG_RING_LEN-1);
+            unsigned int n = tail - head;
+            if (n > EVLOG_RING_LEN - k)
+                n = EVLOG_RING_LEN - k;
+            fwrite(&ring->records[k], sizeof(evlog_record_s), n, _q->fid);
+            head += n;
+        }
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    }
+    fflush(_q->fid);
+}
+
+static void * evlog_writer(void * _arg)
+{
+    evlog q = (evlog) _arg;
+    while (__atomic_load_n(&q->running, __ATOMIC_ACQUIRE)) {
+        event_wait(q->wakeup, EVLOG_DRAIN_PERIOD);
+        evlog_drain(q);
+    }
+    return NULL;
+}
+
+// open _filename for writing, replacing it, and start the writer thread
+evlog evlog_create(const char * _filename, unsigned int _source)
+{
+    evlog q = (evlog) malloc(sizeof(struct evlog_s));
+    // a log holds one header, so a run within the same minute replaces
+    // the file rather than appending to it
+    q->fid = fopen(_filename, "wb");
+    if (q->fid == NULL) {
+        fprintf(stderr,"error: evlog_create(), could not open '%s' for writing\n", _filename);
+        exit(1);
+    }
+    q->num_rings   = 0;
+    q->num_dropped = 0;
+    q->serial      = __atomic_add_fetch(&evlog_num_created, 1, __ATOMIC_RELAXED);
+    pthread_mutex_init(&q->rings_mutex, NULL);
+
+    evlog_header_s header;
+    memset(&header, 0x00, sizeof(header));
+    memcpy(header.magic, EVLOG_MAGIC, 8);
+    header.source     = _source;
+    header.record_len = sizeof(evlog_record_s);
+    header.start_time  = timer_wallclock_ns();
+    header.start_clock = timer_now_ns();
+    fwrite(&header, sizeof(header), 1, q->fid);
+
+    q->wakeup  = event_create();
+    q->running = 1;
+    pthread_create(&q->writer, NULL, evlog_writer, (void*)q);
+    return q;
+}
+
+// drain outstanding records, stop the writer thread and close the file
+void evlog_destroy(evlog _q)
+{
+    __atomic_store_n(&_q->running, 0, __ATOMIC_RELEASE);
+    event_signal(_q->wakeup);
+    pthread_join(_q->writer, NULL);
+    evlog_drain(_q);
+
+    if (_q->num_dropped > 0)
+        fprintf(stderr,"warning: evlog_destroy(), %u records dropped\n", _q->num_dropped);
+
+    unsigned int i;
+    for (i=0; i<_q->num_rings; i++)
+        delete _q->rings[i];
+    for (i=0; i<4; i++) {
+        if (evlog_cache[i].log == _q)
+            evlog_cache[i].log = NULL;
+    }
+
+    fclose(_q->fid);
+    event_destroy(_q->wakeup);
+    pthread_mutex_destroy(&_q->rings_mutex);
+    free(_q);
+}
+
+// record an event from the calling thread
+void evlog_write(evlog        _q,
+                 unsigned int _type,
+                 unsigned int _session,
+                 unsigned int _id,
+                 unsigned int _attempt,
+                 float        _evm,
+                 float        _rssi)
+{
+    if (_q == NULL)
+        return;
+
+    evlog_ring_s * ring = evlog_get_ring(_q);
+    if (ring == NULL) {
+        __atomic_fetch_add(&_q->num_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    unsigned int tail = ring->tail;
+    if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == EVLOG_RING_LEN) {
+        __atomic_fetch_add(&_q->num_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    evlog_record_s * r = &ring->records[tail & (EVLOG_RING_LEN-1)];
+    r->timestamp = timer_now_ns();
+    r->type      = _type;
+    r->session   = _session;
+    r->id        = _id;
+    r->attempt   = _attempt;
+    r->evm       = _evm;
+    r->rssi      = _rssi;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+// number of records dropped because a ring was full
+unsigned int evlog_get_num_dropped(evlog _q)
+{
+    return __atomic_load_n(&_q->num_dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,69 @@
+//
+// evlog
+//
+// Binary event log. Each thread that writes gets its own lock-free ring
+// of fixed-size records; a background thread drains the rings to an
+// append-only file. Writing never blocks or allocates: if a ring is
+// full the record is dropped and counted. LogDecode turns the file back
+// into the bs-*.log / uav-*.log text format.
+//
+
+#ifndef __EVLOG_H__
+#define __EVLOG_H__
+
+#define EVLOG_MAGIC "UAVEVLOG"
+
+// program that wrote the log
+#define EVLOG_SOURCE_BASESTATION 0
+#define EVLOG_SOURCE_UAV         1
+
+// record types
+#define EVLOG_START 0       // program started
+#define EVLOG_DONE  1       // program finished
+#define EVLOG_TX    2       // data frame transmitted
+#define EVLOG_RX    3       // valid data frame received
+#define EVLOG_ACK   4       // data frame acknowledged, after attempt
+                            // transmissions
+
+// file header
+struct evlog_header_s {
+    char magic[8];              // EVLOG_MAGIC, not terminated
+    unsigned int source;        // EVLOG_SOURCE_*
+    unsigned int record_len;    // sizeof(evlog_record_s)
+    long long start_time;       // wall clock at creation [ns since epoch]
+    long long start_clock;      // monotonic clock at creation [ns]
+};
+
+// one event
+struct evlog_record_s {
+    long long timestamp;        // monotonic clock [ns], see timer_now_ns()
+    unsigned int type;          // EVLOG_*
+    unsigned int id;            // packet id
+    unsigned int attempt;       // transmission attempt
+    float evm;                  // receiver stats, 0 if not applicable
+    float rssi;
+    unsigned int session;       // uav session the packet belongs to
+};
+
+typedef struct evlog_s * evlog;
+
+// open _filename for writing (replacing any earlier log of that name)
+// and start the writer thread
+evlog evlog_create(const char * _filename, unsigned int _source);
+
+// drain outstanding records, stop the writer thread and close the file
+void evlog_destroy(evlog _q);
+
+// record an event from the calling thread (no-op if _q is NULL)
+void evlog_write(evlog        _q,
+                 unsigned int _type,
+                 unsigned int _session,
+                 unsigned int _id,
+                 unsigned int _attempt,
+                 float        _evm,
+                 float        _rssi);
+
+// number of records dropped because a ring was full
+unsigned int evlog_get_num_dropped(evlog _q);
+
+#endif // __EVLOG_H__
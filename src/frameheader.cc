@@ -0,0 +1,44 @@
+//
+// frameheader
+//
+
+#include "frameheader.h"
+
+// write header to _header[0..FRAMEHEADER_LEN-1]
+void frameheader_encode(const frameheader_s * _q, unsigned char * _header)
+{
+    _header[0] = (_q->seq >> 24) & 0xff;
+    _header[1] = (_q->seq >> 16) & 0xff;
+    _header[2] = (_q->seq >>  8) & 0xff;
+    _header[3] = (_q->seq      ) & 0xff;
+    _header[4] = _q->type    & 0xff;
+    _header[5] = _q->session & 0xff;
+    _header[6] = _q->flags   & 0xff;
+    _header[7] = _q->info    & 0xff;
+}
+
+// read header from _header[0..FRAMEHEADER_LEN-1]
+void frameheader_decode(frameheader_s * _q, const unsigned char * _header)
+{
+    _q->seq     = (unsigned int)_header[0] << 24 |
+                  (unsigned int)_header[1] << 16 |
+                  (unsigned int)_header[2] <<  8 |
+                  (unsigned int)_header[3];
+    _q->type    = _header[4];
+    _q->session = _header[5];
+    _q->flags   = _header[6];
+    _q->info    = _header[7];
+}
+
+// signed distance from sequence number _b to _a: the difference modulo
+// 2^32, read as two's complement
+int frameheader_seq_diff(unsigned int _a, unsigned int _b)
+{
+    return (int)(_a - _b);
+}
+
+// does sequence number _a come before _b?
+int frameheader_seq_lt(unsigned int _a, unsigned int _b)
+{
+    return frameheader_seq_diff(_a, _b) < 0;
+}
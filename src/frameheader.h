@@ -0,0 +1,56 @@
+//
+// frameheader
+//
+// Layout of the 8 user bytes of every frame header. Data frames are
+// numbered with a 32-bit sequence number that wraps around; sequence
+// numbers are compared with serial-number arithmetic (RFC 1982), so
+// ordering holds across the wrap as long as the numbers compared are
+// less than 2^31 apart.
+//
+//  header[0..3] : sequence number, big-endian (block ack: base sequence,
+//                 repair: sequence number of the block's first frame)
+//  header[4]    : frame type, FRAMEHEADER_TYPE_*
+//  header[5]    : session id
+//  header[6]    : flags, FRAMEHEADER_FLAG_*
+//  header[7]    : type-specific: transmission attempt (data), bitmap
+//                 length in bytes (block ack), repair index (repair)
+//
+
+#ifndef __FRAMEHEADER_H__
+#define __FRAMEHEADER_H__
+
+// number of header bytes used
+#define FRAMEHEADER_LEN 8
+
+// frame types
+#define FRAMEHEADER_TYPE_DATA     0     // base station to uav
+#define FRAMEHEADER_TYPE_ACK      1     // single-packet ack
+#define FRAMEHEADER_TYPE_NACK     2     // single-packet nack
+#define FRAMEHEADER_TYPE_BLOCKACK 3     // see blockack.h
+#define FRAMEHEADER_TYPE_REPAIR   4     // base station to uav, see erasure.h
+
+// flags
+#define FRAMEHEADER_FLAG_AGGREGATED 0x01   // payload holds length-prefixed
+                                           // messages, see aggregator.h
+
+struct frameheader_s {
+    unsigned int seq;           // sequence number
+    unsigned int type;          // FRAMEHEADER_TYPE_*
+    unsigned int session;       // session id, [0,255]
+    unsigned int flags;         // FRAMEHEADER_FLAG_*
+    unsigned int info;          // type-specific byte, [0,255]
+};
+
+// write header to _header[0..FRAMEHEADER_LEN-1]
+void frameheader_encode(const frameheader_s * _q, unsigned char * _header);
+
+// read header from _header[0..FRAMEHEADER_LEN-1]
+void frameheader_decode(frameheader_s * _q, const unsigned char * _header);
+
+// signed distance from sequence number _b to _a
+int frameheader_seq_diff(unsigned int _a, unsigned int _b);
+
+// does sequence number _a come before _b?
+int frameheader_seq_lt(unsigned int _a, unsigned int _b);
+
+#endif // __FRAMEHEADER_H__
@@ -0,0 +1,194 @@
+//
+// harq
+//
+
+#include <stdlib.h>
+#include <math.h>
+#include "harq.h"
+
+// bound on the per-copy weight, 10^(60/10), for frames with a near
+// perfect EVM
+#define HARQ_MAX_EVM_WEIGHT 1e6f
+
+struct harq_slot_s {
+    unsigned int id;
+    int in_use;
+    // frame parameters; a copy sent differently cannot be combined
+    unsigned int mod_scheme;
+    unsigned int check;
+    unsigned int fec0;
+    unsigned int fec1;
+    unsigned int payload_len;
+    unsigned int num_syms;
+    // weighted sum of the copies received so far, and sum of weights
+    liquid_float_complex * syms;
+    unsigned int syms_len;      // allocated length
+    float weight;
+};
+
+struct harq_s {
+    harq_slot_s * slots;
+    unsigned int capacity;      // power of two
+
+    // decoder for the last parameters seen, rebuilt when they change
+    modem demod;
+    unsigned int demod_scheme;
+    packetizer p;
+    unsigned int p_payload_len;
+    unsigned int p_check;
+    unsigned int p_fec0;
+    unsigned int p_fec1;
+
+    unsigned char * softbits;
+    unsigned int softbits_len;
+    unsigned char * payload;
+    unsigned int payload_len;
+};
+
+// create store
+harq harq_create(unsigned int _capacity)
+{
+    unsigned int capacity = 1;
+    while (capacity < _capacity)
+        capacity <<= 1;
+
+    harq q = (harq) malloc(sizeof(struct harq_s));
+    q->capacity = capacity;
+    q->slots    = (harq_slot_s*) calloc(capacity, sizeof(harq_slot_s));
+
+    q->demod        = NULL;
+    q->demod_scheme = 0;
+    q->p            = NULL;
+    q->softbits     = NULL;
+    q->softbits_len = 0;
+    q->payload      = NULL;
+    q->payload_len  = 0;
+    return q;
+}
+
+// destroy store
+void harq_destroy(harq _q)
+{
+    unsigned int i;
+    for (i=0; i<_q->capacity; i++)
+        free(_q->slots[i].syms);
+    free(_q->slots);
+    if (_q->demod != NULL)
+        modem_destroy(_q->demod);
+    if (_q->p != NULL)
+        packetizer_destroy(_q->p);
+    free(_q->softbits);
+    free(_q->payload);
+    free(_q);
+}
+
+// soft-demodulate and decode the combined symbols of a slot
+static unsigned char * harq_decode(harq _q, harq_slot_s * _s)
+{
+    if (_q->demod == NULL || _q->demod_scheme != _s->mod_scheme) {
+        if (_q->demod != NULL)
+            modem_destroy(_q->demod);
+        _q->demod = modem_create((modulation_scheme)_s->mod_scheme);
+        _q->demod_scheme = _s->mod_scheme;
+    }
+    if (_q->p == NULL || _q->p_payload_len != _s->payload_len ||
+        _q->p_check != _s->check || _q->p_fec0 != _s->fec0 || _q->p_fec1 != _s->fec1)
+    {
+        if (_q->p != NULL)
+            packetizer_destroy(_q->p);
+        _q->p = packetizer_create(_s->payload_len, _s->check, _s->fec0, _s->fec1);
+        _q->p_payload_len = _s->payload_len;
+        _q->p_check       = _s->check;
+        _q->p_fec0        = _s->fec0;
+        _q->p_fec1        = _s->fec1;
+    }
+
+    // the payload symbols must carry at least the encoded message
+    unsigned int bps = modem_get_bps(_q->demod);
+    unsigned int num_bits = 8*packetizer_get_enc_msg_len(_q->p);
+    if (_s->num_syms*bps < num_bits)
+        return NULL;
+
+    if (_q->softbits_len < _s->num_syms*bps) {
+        _q->softbits_len = _s->num_syms*bps;
+        _q->softbits = (unsigned char*) realloc(_q->softbits, _q->softbits_len);
+    }
+    if (_q->payload_len < _s->payload_len) {
+        _q->payload_len = _s->payload_len;
+        _q->payload = (unsigned char*) realloc(_q->payload, _q->payload_len);
+    }
+
+    unsigned int i;
+    unsigned int sym;
+    for (i=0; i<_s->num_syms; i++)
+        modem_demodulate_soft(_q->demod, _s->syms[i] / _s->weight, &sym, &_q->softbits[i*bps]);
+
+    return packetizer_decode_soft(_q->p, _q->softbits, _q->payload) ? _q->payload : NULL;
+}
+
+// combine failed payload with earlier copies and try to decode it
+unsigned char * harq_combine(harq               _q,
+                             unsigned int       _id,
+                             framesyncstats_s * _stats,
+                             unsigned int       _payload_len)
+{
+    if (_stats->framesyms == NULL || _stats->num_framesyms == 0)
+        return NULL;
+
+    harq_slot_s * s = &_q->slots[_id & (_q->capacity-1)];
+
+    // Chase combining needs the same symbols, so only copies of the
+    // same packet sent with the same modulation and coding are added up
+    int combine = s->in_use && s->id == _id &&
+                  s->mod_scheme  == _stats->mod_scheme &&
+                  s->check       == _stats->check &&
+                  s->fec0        == _stats->fec0 &&
+                  s->fec1        == _stats->fec1 &&
+                  s->payload_len == _payload_len &&
+                  s->num_syms    == _stats->num_framesyms;
+
+    // weight each copy by its signal-to-error ratio
+    float w = powf(10.0f, -_stats->evm/10.0f);
+    if (!(w < HARQ_MAX_EVM_WEIGHT))
+        w = HARQ_MAX_EVM_WEIGHT;
+
+    unsigned int i;
+    if (!combine) {
+        // first copy (or one that cannot be combined): start over
+        if (s->syms_len < _stats->num_framesyms) {
+            s->syms_len = _stats->num_framesyms;
+            s->syms = (liquid_float_complex*) realloc(s->syms, s->syms_len*sizeof(liquid_float_complex));
+        }
+        s->id          = _id;
+        s->in_use      = 1;
+        s->mod_scheme  = _stats->mod_scheme;
+        s->check       = _stats->check;
+        s->fec0        = _stats->fec0;
+        s->fec1        = _stats->fec1;
+        s->payload_len = _payload_len;
+        s->num_syms    = _stats->num_framesyms;
+        for (i=0; i<s->num_syms; i++)
+            s->syms[i] = w * _stats->framesyms[i];
+        s->weight = w;
+
+        // a lone copy already failed the receiver's own decode
+        return NULL;
+    }
+
+    for (i=0; i<s->num_syms; i++)
+        s->syms[i] += w * _stats->framesyms[i];
+    s->weight += w;
+
+    unsigned char * payload = harq_decode(_q, s);
+    if (payload != NULL)
+        s->in_use = 0;
+    return payload;
+}
+
+// forget packet _id
+void harq_clear(harq _q, unsigned int _id)
+{
+    harq_slot_s * s = &_q->slots[_id & (_q->capacity-1)];
+    if (s->in_use && s->id == _id)
+        s->in_use = 0;
+}
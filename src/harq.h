@@ -0,0 +1,39 @@
+//
+// harq
+//
+// Soft-combining store for the UAV receiver (hybrid ARQ). When a
+// payload fails its CRC, the frame's equalized payload symbols are kept,
+// keyed by packet id. A retransmission that also fails is combined with
+// them (Chase combining, each copy weighted by its EVM). The combined
+// symbols are then soft-demodulated and decoded again. Slots are indexed
+// by id modulo the capacity, so a newer packet evicts an older one that
+// maps to the same slot.
+//
+
+#ifndef __HARQ_H__
+#define __HARQ_H__
+
+#include <liquid/liquid.h>
+
+typedef struct harq_s * harq;
+
+// create store keeping up to _capacity failed packets (rounded up to a
+// power of two)
+harq harq_create(unsigned int _capacity);
+
+// destroy store
+void harq_destroy(harq _q);
+
+// combine the failed payload of packet _id, as described by _stats,
+// with earlier copies and try to decode it. Returns the recovered
+// payload (valid until the next call), or NULL if it is still
+// undecodable, in which case the copy is kept for next time.
+unsigned char * harq_combine(harq               _q,
+                             unsigned int       _id,
+                             framesyncstats_s * _stats,
+                             unsigned int       _payload_len);
+
+// forget packet _id (received intact)
+void harq_clear(harq _q, unsigned int _id);
+
+#endif // __HARQ_H__
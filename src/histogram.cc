@@ -0,0 +1,104 @@
+//
+// histogram
+//
+
+#include <math.h>
+#include <string.h>
+#include "histogram.h"
+
+// clear histogram and set its range
+void histogram_init(histogram_s * _q, float _min, float _max, int _log_scale)
+{
+    memset(_q, 0x00, sizeof(histogram_s));
+    _q->min = _min;
+    _q->max = _max;
+    _q->log_scale = _log_scale;
+}
+
+// position of _value across the range, 0 at min and 1 at max
+static float histogram_position(const histogram_s * _q, float _value)
+{
+    if (_q->log_scale)
+        return _value <= 0 ? 0.0f : logf(_value / _q->min) / logf(_q->max / _q->min);
+    return (_value - _q->min) / (_q->max - _q->min);
+}
+
+// upper edge of bin _i
+static float histogram_edge(const histogram_s * _q, unsigned int _i)
+{
+    float x = (float)(_i + 1) / HISTOGRAM_NUM_BINS;
+    if (_q->log_scale)
+        return _q->min * powf(_q->max / _q->min, x);
+    return _q->min + x * (_q->max - _q->min);
+}
+
+// add one sample
+void histogram_add(histogram_s * _q, float _value)
+{
+    float x = histogram_position(_q, _value) * HISTOGRAM_NUM_BINS;
+    unsigned int i = x < 0 ? 0 : x >= HISTOGRAM_NUM_BINS ? HISTOGRAM_NUM_BINS - 1 : (unsigned int)x;
+    __atomic_add_fetch(&_q->bins[i], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&_q->count, 1, __ATOMIC_RELAXED);
+
+    // no atomic add for doubles: swap in the new sum until no other
+    // thread got there first
+    double sum;
+    double next;
+    __atomic_load(&_q->sum, &sum, __ATOMIC_RELAXED);
+    do {
+        next = sum + _value;
+    } while (!__atomic_compare_exchange(&_q->sum, &sum, &next, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// set _q to a copy of _src
+void histogram_copy(histogram_s * _q, const histogram_s * _src)
+{
+    histogram_init(_q, _src->min, _src->max, _src->log_scale);
+    histogram_merge(_q, _src);
+}
+
+// add every sample of _src to _q
+void histogram_merge(histogram_s * _q, const histogram_s * _src)
+{
+    unsigned int i;
+    for (i=0; i<HISTOGRAM_NUM_BINS; i++)
+        _q->bins[i] += __atomic_load_n(&_src->bins[i], __ATOMIC_RELAXED);
+    _q->count += __atomic_load_n(&_src->count, __ATOMIC_RELAXED);
+    double sum;
+    __atomic_load(&_src->sum, &sum, __ATOMIC_RELAXED);
+    _q->sum += sum;
+}
+
+// number of samples
+unsigned long long histogram_count(const histogram_s * _q)
+{
+    return __atomic_load_n(&_q->count, __ATOMIC_RELAXED);
+}
+
+// mean of the samples
+float histogram_mean(const histogram_s * _q)
+{
+    unsigned long long n = histogram_count(_q);
+    double sum;
+    __atomic_load(&_q->sum, &sum, __ATOMIC_RELAXED);
+    return n == 0 ? 0.0f : sum / n;
+}
+
+// value below which the fraction _p of samples fall
+float histogram_percentile(const histogram_s * _q, float _p)
+{
+    unsigned long long n = histogram_count(_q);
+    if (n == 0)
+        return 0.0f;
+
+    unsigned long long target = (unsigned long long)ceil(_p * n);
+    unsigned long long total = 0;
+    unsigned int i;
+    for (i=0; i<HISTOGRAM_NUM_BINS; i++) {
+        total += __atomic_load_n(&_q->bins[i], __ATOMIC_RELAXED);
+        if (total >= target && total > 0)
+            return histogram_edge(_q, i);
+    }
+    return _q->max;
+}
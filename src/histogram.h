@@ -0,0 +1,52 @@
+//
+// histogram
+//
+// Fixed-size histogram of a measured quantity (round-trip time, EVM,
+// RSSI). Bins are spread evenly over [min,max], or over the logarithm
+// of the range for quantities spanning decades; values outside the
+// range land in the first or last bin. Samples are counted with
+// relaxed atomic increments, so any thread may add samples while
+// others read, and the struct holds no pointers, so it can be copied
+// or shared as is.
+//
+
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+// number of bins
+#define HISTOGRAM_NUM_BINS 128
+
+struct histogram_s {
+    float min;                  // lower edge of the first bin
+    float max;                  // upper edge of the last bin
+    int log_scale;              // bins evenly spaced in log(value)
+    unsigned long long count;   // number of samples
+    double sum;                 // sum of samples, for the mean
+    unsigned long long bins[HISTOGRAM_NUM_BINS];
+};
+
+// clear histogram and set its range; _min must be positive if
+// _log_scale is set
+void histogram_init(histogram_s * _q, float _min, float _max, int _log_scale);
+
+// add one sample
+void histogram_add(histogram_s * _q, float _value);
+
+// set _q to a copy of _src, read sample by sample so _src may be
+// added to meanwhile
+void histogram_copy(histogram_s * _q, const histogram_s * _src);
+
+// add every sample of _src to _q (same range)
+void histogram_merge(histogram_s * _q, const histogram_s * _src);
+
+// number of samples
+unsigned long long histogram_count(const histogram_s * _q);
+
+// mean of the samples, 0 if there are none
+float histogram_mean(const histogram_s * _q);
+
+// value below which the fraction _p of samples fall, read at the
+// upper edge of its bin; 0 if there are no samples
+float histogram_percentile(const histogram_s * _q, float _p);
+
+#endif // __HISTOGRAM_H__
@@ -0,0 +1,130 @@
+//
+// inflight
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "inflight.h"
+
+struct inflight_s {
+    packet * slots;
+    unsigned char * arena;      // payload buffers for all slots
+    unsigned int payload_len;
+    unsigned int capacity;      // number of slots, power of two
+    unsigned int size;          // number of packets in flight
+    unsigned int base;          // oldest id that may still be in flight
+    unsigned int next;          // one past the newest id inserted
+};
+
+// create table
+inflight inflight_create(unsigned int _capacity,
+                         unsigned int _payload_len)
+{
+    // a power of two, so slots evenly divide the id space and the ring
+    // stays consistent when ids wrap
+    unsigned int capacity = 1;
+    while (capacity < _capacity && capacity < INFLIGHT_MAX_CAPACITY)
+        capacity <<= 1;
+
+    inflight q = (inflight) malloc(sizeof(struct inflight_s));
+    q->slots    = (packet*) calloc(capacity, sizeof(packet));
+    q->capacity = capacity;
+    q->size     = 0;
+    q->base     = 0;
+    q->next     = 0;
+
+    // one allocation for every payload; each slot's buffer is fixed
+    // for the lifetime of the table
+    q->payload_len = _payload_len;
+    q->arena = (unsigned char*) malloc(capacity*_payload_len);
+
+    return q;
+}
+
+// destroy table
+void inflight_destroy(inflight _q)
+{
+    free(_q->arena);
+    free(_q->slots);
+    free(_q);
+}
+
+// payload buffer length of each slot
+unsigned int inflight_get_payload_len(inflight _q)
+{
+    return _q->payload_len;
+}
+
+// number of packets in flight
+unsigned int inflight_size(inflight _q)
+{
+    return _q->size;
+}
+
+// can packet _id be added without reusing a slot still in flight?
+int inflight_can_insert(inflight _q, unsigned int _id)
+{
+    return _id - _q->base < _q->capacity;
+}
+
+// claim the slot for packet _id
+packet * inflight_insert(inflight _q, unsigned int _id)
+{
+    if (!inflight_can_insert(_q, _id)) {
+        fprintf(stderr,"warning: inflight_insert(), id %u outside window\n", _id);
+        return NULL;
+    }
+
+    packet * pk = &_q->slots[_id & (_q->capacity-1)];
+    if (pk->in_flight)
+        return NULL;
+
+    pk->id          = _id;
+    pk->tx_attempts = 0;
+    pk->data        = &_q->arena[(size_t)(_id & (_q->capacity-1)) * _q->payload_len];
+    pk->borrowed    = 0;
+    pk->len         = _q->payload_len;
+    pk->in_flight   = 1;
+    _q->size++;
+    if (_id - _q->base >= _q->next - _q->base)
+        _q->next = _id + 1;
+    return pk;
+}
+
+// look up packet by id
+packet * inflight_get(inflight _q, unsigned int _id)
+{
+    packet * pk = &_q->slots[_id & (_q->capacity-1)];
+    return (pk->in_flight && pk->id == _id) ? pk : NULL;
+}
+
+// drop packet _id
+int inflight_remove(inflight _q, unsigned int _id)
+{
+    packet * pk = inflight_get(_q, _id);
+    if (pk == NULL)
+        return 0;
+
+    pk->in_flight = 0;
+    _q->size--;
+
+    // slide the base past every slot that has been freed; each id is
+    // stepped over once, so this is constant time amortized
+    while (_q->base != _q->next &&
+           !_q->slots[_q->base & (_q->capacity-1)].in_flight)
+    {
+        _q->base++;
+    }
+    return 1;
+}
+
+// ids [base, next) span every packet still in flight
+unsigned int inflight_base(inflight _q)
+{
+    return _q->base;
+}
+
+unsigned int inflight_next(inflight _q)
+{
+    return _q->next;
+}
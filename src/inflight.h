@@ -0,0 +1,62 @@
+//
+// inflight
+//
+// Table of packets sent by the base station but not yet acknowledged.
+// Packets live in a ring of stable slots indexed by id % capacity, so
+// inserting, finding and removing a packet are all constant-time. Each
+// slot owns a payload buffer carved from one arena allocated up front,
+// so the payload is written, sent and resent in place.
+//
+
+#ifndef __INFLIGHT_H__
+#define __INFLIGHT_H__
+
+// largest table, keeping every id in flight within half the 32-bit
+// sequence space
+#define INFLIGHT_MAX_CAPACITY (1u << 30)
+
+struct packet {
+    unsigned int id;
+    unsigned int tx_attempts;
+    unsigned char * data;       // payload, the slot's own buffer unless
+                                // pointed at bytes that outlive the packet
+    int borrowed;               // data is not the slot's buffer
+    unsigned int len;           // payload bytes in use
+    long long tx_time;          // last transmission [ns]
+    int in_flight;
+};
+
+typedef struct inflight_s * inflight;
+
+// create table holding at least _capacity packets (rounded up to a
+// power of two no larger than INFLIGHT_MAX_CAPACITY) of _payload_len
+// bytes
+inflight inflight_create(unsigned int _capacity,
+                         unsigned int _payload_len);
+
+// destroy table
+void inflight_destroy(inflight _q);
+
+// payload buffer length of each slot
+unsigned int inflight_get_payload_len(inflight _q);
+
+// number of packets in flight
+unsigned int inflight_size(inflight _q);
+
+// can packet _id be added without reusing a slot still in flight?
+int inflight_can_insert(inflight _q, unsigned int _id);
+
+// claim the slot for packet _id; returns NULL if the slot is taken
+packet * inflight_insert(inflight _q, unsigned int _id);
+
+// look up packet by id; returns NULL if not in flight
+packet * inflight_get(inflight _q, unsigned int _id);
+
+// drop packet _id; returns 0 if it was not in flight
+int inflight_remove(inflight _q, unsigned int _id);
+
+// ids [base, next) span every packet still in flight
+unsigned int inflight_base(inflight _q);
+unsigned int inflight_next(inflight _q);
+
+#endif // __INFLIGHT_H__
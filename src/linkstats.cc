@@ -0,0 +1,164 @@
+//
+// linkstats
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "timer.h"
+#include "event.h"
+#include "linkstats.h"
+
+struct linkstats_s {
+    char * name;
+    linkstats_page_s * page;            // the shared segment
+    linkstats_page_s snapshot;          // filled before being copied in
+    float period;
+    linkstats_fill fill;
+    void * userdata;
+
+    pthread_t publisher;
+    event wakeup;
+    int running;
+};
+
+// fill a snapshot and copy it into the segment between two bumps of
+// the sequence count
+static void linkstats_publish(linkstats _q, int _running)
+{
+    linkstats_page_s * s = &_q->snapshot;
+    _q->fill(s, _q->userdata);
+    s->update_clock = timer_now_ns();
+    s->running = _running;
+
+    unsigned int seq = _q->page->seq;
+    __atomic_store_n(&_q->page->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    s->seq = seq + 1;
+    memcpy(_q->page, s, sizeof(linkstats_page_s));
+    __atomic_store_n(&_q->page->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void * linkstats_publisher(void * _arg)
+{
+    linkstats q = (linkstats) _arg;
+    while (__atomic_load_n(&q->running, __ATOMIC_ACQUIRE)) {
+        event_wait(q->wakeup, q->period);
+        linkstats_publish(q, 1);
+    }
+    return NULL;
+}
+
+// create segment and start the publisher thread
+linkstats linkstats_create(const char *   _name,
+                           unsigned int   _source,
+                           float          _period,
+                           linkstats_fill _fill,
+                           void *         _userdata)
+{
+    shm_unlink(_name);
+    int fd = shm_open(_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        fprintf(stderr,"warning: linkstats_create(), could not create shared memory '%s'\n", _name);
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(linkstats_page_s)) < 0) {
+        fprintf(stderr,"warning: linkstats_create(), could not size shared memory '%s'\n", _name);
+        close(fd);
+        shm_unlink(_name);
+        return NULL;
+    }
+    void * page = mmap(NULL, sizeof(linkstats_page_s), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        fprintf(stderr,"warning: linkstats_create(), could not map shared memory '%s'\n", _name);
+        shm_unlink(_name);
+        return NULL;
+    }
+
+    linkstats q = (linkstats) malloc(sizeof(struct linkstats_s));
+    q->name     = strdup(_name);
+    q->page     = (linkstats_page_s*) page;
+    q->period   = _period;
+    q->fill     = _fill;
+    q->userdata = _userdata;
+
+    // the header fields never change after this
+    linkstats_page_s * s = &q->snapshot;
+    memset(s, 0x00, sizeof(linkstats_page_s));
+    s->magic       = LINKSTATS_MAGIC;
+    s->version     = LINKSTATS_VERSION;
+    s->source      = _source;
+    s->pid         = getpid();
+    s->start_clock = timer_now_ns();
+    linkstats_publish(q, 1);
+
+    q->wakeup  = event_create();
+    q->running = 1;
+    pthread_create(&q->publisher, NULL, linkstats_publisher, (void*)q);
+    return q;
+}
+
+// publish a last snapshot, stop the publisher and remove the segment
+void linkstats_destroy(linkstats _q)
+{
+    if (_q == NULL)
+        return;
+    __atomic_store_n(&_q->running, 0, __ATOMIC_RELEASE);
+    event_signal(_q->wakeup);
+    pthread_join(_q->publisher, NULL);
+    linkstats_publish(_q, 0);
+
+    munmap(_q->page, sizeof(linkstats_page_s));
+    shm_unlink(_q->name);
+    event_destroy(_q->wakeup);
+    free(_q->name);
+    free(_q);
+}
+
+// map segment read-only
+const linkstats_page_s * linkstats_map(const char * _name)
+{
+    int fd = shm_open(_name, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(linkstats_page_s)) {
+        close(fd);
+        return NULL;
+    }
+    void * page = mmap(NULL, sizeof(linkstats_page_s), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return page == MAP_FAILED ? NULL : (const linkstats_page_s*) page;
+}
+
+// unmap segment
+void linkstats_unmap(const linkstats_page_s * _page)
+{
+    munmap((void*)_page, sizeof(linkstats_page_s));
+}
+
+// copy a consistent snapshot
+int linkstats_read(const linkstats_page_s * _page, linkstats_page_s * _copy)
+{
+    unsigned int seq;
+    while (1) {
+        seq = __atomic_load_n(&_page->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            // publisher is mid-copy, which takes microseconds
+            usleep(100);
+            continue;
+        }
+        memcpy(_copy, _page, sizeof(linkstats_page_s));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&_page->seq, __ATOMIC_RELAXED) == seq)
+            break;
+    }
+    _copy->seq = seq;
+    return _copy->magic == LINKSTATS_MAGIC && _copy->version == LINKSTATS_VERSION;
+}
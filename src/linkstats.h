@@ -0,0 +1,82 @@
+//
+// linkstats
+//
+// Live link statistics in a POSIX shared-memory segment. The program
+// running the link publishes a snapshot of its counters and histograms
+// from a background thread every period; uavstat maps the segment read
+// only and prints it while the link runs. Each snapshot is bracketed by
+// a sequence count, so readers retry torn copies instead of locking out
+// the writer.
+//
+
+#ifndef __LINKSTATS_H__
+#define __LINKSTATS_H__
+
+#include "histogram.h"
+
+#define LINKSTATS_MAGIC   0x55415653    // "UAVS"
+#define LINKSTATS_VERSION 1
+
+// program publishing the segment
+#define LINKSTATS_SOURCE_BASESTATION 0
+#define LINKSTATS_SOURCE_UAV         1
+
+// default segment names
+#define LINKSTATS_NAME_BASESTATION "/uavlink-bs"
+#define LINKSTATS_NAME_UAV         "/uavlink-uav"
+
+// layout of the segment; counters a source does not keep stay 0
+struct linkstats_page_s {
+    unsigned int magic;                 // LINKSTATS_MAGIC
+    unsigned int version;               // LINKSTATS_VERSION
+    unsigned int seq;                   // odd while a snapshot is written
+    unsigned int source;                // LINKSTATS_SOURCE_*
+    int pid;                            // publishing process
+    int running;                        // cleared when the publisher exits
+    long long start_clock;              // monotonic clock at creation [ns]
+    long long update_clock;             // monotonic clock of the snapshot [ns]
+
+    unsigned int frames_sent;           // data or block-ack frames sent
+    unsigned int frames_detected;       // frames seen by the receiver
+    unsigned int packets_delivered;     // bs: acked, uav: valid payloads
+    unsigned int bytes_delivered;       // payload bytes of those packets
+    unsigned int acks;                  // bs: acks received
+    unsigned int nacks;                 // bs: nacks received
+    unsigned int timeouts;              // bs: retransmission timeouts
+    unsigned int harq_recovered;        // uav: payloads decoded by combining
+    unsigned int messages;              // uav: aggregated messages received
+
+    histogram_s rtt;                    // bs: ack round-trip time [s]
+    histogram_s evm;                    // forward-link EVM [dB]
+    histogram_s rssi;                   // forward-link RSSI [dB]
+};
+
+// fill in the counters and histograms of a snapshot
+typedef void (*linkstats_fill)(linkstats_page_s * _page, void * _userdata);
+
+typedef struct linkstats_s * linkstats;
+
+// create segment _name (replacing any left behind) and publish a
+// snapshot from _fill every _period seconds; returns NULL if shared
+// memory is unavailable
+linkstats linkstats_create(const char *   _name,
+                           unsigned int   _source,
+                           float          _period,
+                           linkstats_fill _fill,
+                           void *         _userdata);
+
+// publish a last snapshot, stop the publisher thread and remove the
+// segment (readers keep their mapping)
+void linkstats_destroy(linkstats _q);
+
+// map segment _name read-only; returns NULL if there is none
+const linkstats_page_s * linkstats_map(const char * _name);
+
+// unmap a segment mapped by linkstats_map()
+void linkstats_unmap(const linkstats_page_s * _page);
+
+// copy a consistent snapshot of _page; returns 0 if the segment is not
+// a linkstats page of this version
+int linkstats_read(const linkstats_page_s * _page, linkstats_page_s * _copy);
+
+#endif // __LINKSTATS_H__
@@ -0,0 +1,146 @@
+//
+// ratectl
+//
+
+#include <stdlib.h>
+#include "ratectl.h"
+
+// EVM smoothing
+#define RATECTL_ALPHA 0.3f
+
+// margin below the next rate's EVM limit before stepping up [dB]
+#define RATECTL_HYSTERESIS 2.0f
+
+// consecutive good reports needed to step up
+#define RATECTL_UP_COUNT 4
+
+// consecutive loss events that force a step down
+#define RATECTL_MAX_LOSSES 2
+
+// share of nacks in a block ack above which it is a loss event; a few
+// nacks are random frame errors, not a rate the link can't carry
+#define RATECTL_MAX_NACK_RATIO 0.5f
+
+// rates in increasing order of throughput; EVM limits are the SNR each
+// needs for a low frame error rate, as EVM ~ -SNR
+static const ratectl_rate_s ratectl_table[] = {
+    {LIQUID_MODEM_BPSK,  LIQUID_FEC_CONV_V29,    LIQUID_FEC_RS_M8, 1, 100.0f},
+    {LIQUID_MODEM_QPSK,  LIQUID_FEC_CONV_V29,    LIQUID_FEC_RS_M8, 2,  -6.0f},
+    {LIQUID_MODEM_QPSK,  LIQUID_FEC_CONV_V29P23, LIQUID_FEC_RS_M8, 2,  -8.0f},
+    {LIQUID_MODEM_QAM16, LIQUID_FEC_CONV_V29,    LIQUID_FEC_RS_M8, 4, -12.0f},
+    {LIQUID_MODEM_QAM16, LIQUID_FEC_CONV_V29P23, LIQUID_FEC_RS_M8, 4, -15.0f},
+    {LIQUID_MODEM_QAM64, LIQUID_FEC_CONV_V29P23, LIQUID_FEC_RS_M8, 6, -21.0f},
+    {LIQUID_MODEM_QAM64, LIQUID_FEC_NONE,        LIQUID_FEC_RS_M8, 6, -27.0f},
+};
+
+#define RATECTL_NUM_RATES (sizeof(ratectl_table)/sizeof(ratectl_table[0]))
+
+struct ratectl_s {
+    unsigned int index;         // current rate
+    float evm;                  // smoothed EVM [dB]
+    int have_evm;
+    unsigned int num_good;      // reports in a row good enough to step up
+    unsigned int num_losses;    // loss events with no ack in between
+};
+
+// create controller
+ratectl ratectl_create()
+{
+    ratectl q = (ratectl) malloc(sizeof(struct ratectl_s));
+    q->index      = 0;
+    q->evm        = 0.0f;
+    q->have_evm   = 0;
+    q->num_good   = 0;
+    q->num_losses = 0;
+    return q;
+}
+
+// destroy controller
+void ratectl_destroy(ratectl _q)
+{
+    free(_q);
+}
+
+// rate to send the next frame at
+const ratectl_rate_s * ratectl_get(ratectl _q)
+{
+    return &ratectl_table[_q->index];
+}
+
+// EVM reported by the receiver
+void ratectl_update(ratectl _q, float _evm)
+{
+    _q->evm = _q->have_evm ? (1.0f - RATECTL_ALPHA)*_q->evm + RATECTL_ALPHA*_evm : _evm;
+    _q->have_evm = 1;
+
+    // back off straight away once the link can no longer carry the rate
+    while (_q->index > 0 && _q->evm > ratectl_table[_q->index].max_evm) {
+        _q->index--;
+        _q->num_good = 0;
+    }
+
+    // step up one rate at a time, only on a sustained margin
+    if (_q->index + 1 < RATECTL_NUM_RATES &&
+        _q->evm < ratectl_table[_q->index+1].max_evm - RATECTL_HYSTERESIS)
+    {
+        if (++_q->num_good >= RATECTL_UP_COUNT) {
+            _q->index++;
+            _q->num_good = 0;
+        }
+    } else {
+        _q->num_good = 0;
+    }
+}
+
+// loss event
+void ratectl_loss(ratectl _q)
+{
+    _q->num_good = 0;
+    if (++_q->num_losses >= RATECTL_MAX_LOSSES && _q->index > 0) {
+        _q->index--;
+        _q->num_losses = 0;
+    }
+}
+
+// frame acknowledged
+void ratectl_ack(ratectl _q)
+{
+    _q->num_losses = 0;
+}
+
+// block ack outcome
+void ratectl_report(ratectl      _q,
+                    unsigned int _num_acked,
+                    unsigned int _num_nacked)
+{
+    unsigned int n = _num_acked + _num_nacked;
+    if (n == 0)
+        return;
+    if (_num_nacked > RATECTL_MAX_NACK_RATIO * n)
+        ratectl_loss(_q);
+    else
+        ratectl_ack(_q);
+}
+
+// fill rate with a fixed modulation and coding
+void ratectl_rate_init(ratectl_rate_s *  _rate,
+                       modulation_scheme _ms,
+                       fec_scheme        _fec0,
+                       fec_scheme        _fec1)
+{
+    modem mod = modem_create(_ms);
+    _rate->ms      = _ms;
+    _rate->fec0    = _fec0;
+    _rate->fec1    = _fec1;
+    _rate->bps     = modem_get_bps(mod);
+    _rate->max_evm = 100.0f;
+    modem_destroy(mod);
+}
+
+// OFDM payload symbols needed to send _payload_len bytes
+float ratectl_airtime(const ratectl_rate_s * _rate, unsigned int _payload_len)
+{
+    // ofdmflexframegen appends a 32-bit crc before coding
+    unsigned int enc_len = packetizer_compute_enc_msg_len(_payload_len, LIQUID_CRC_32, _rate->fec0, _rate->fec1);
+    return 8.0f * enc_len / _rate->bps;
+}
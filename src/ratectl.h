@@ -0,0 +1,63 @@
+//
+// ratectl
+//
+// Per-link modulation and coding choice. A fixed table orders the
+// usable rates from BPSK with strong FEC up to uncoded 64-QAM. Each
+// rate lists the worst receiver EVM it tolerates. The controller
+// smooths the EVM the UAV reports and applies hysteresis:
+//  - It steps up only after several reports with a margin to spare.
+//  - It steps down as soon as the link no longer supports the current
+//    rate, or after consecutive loss events: block acks nacking most of
+//    what they cover, or bursts of timeouts with no report at all.
+//
+
+#ifndef __RATECTL_H__
+#define __RATECTL_H__
+
+#include <liquid/liquid.h>
+
+struct ratectl_rate_s {
+    modulation_scheme ms;
+    fec_scheme fec0;            // inner fec
+    fec_scheme fec1;            // outer fec
+    unsigned int bps;           // bits per symbol of ms
+    float max_evm;              // worst EVM the rate works at [dB]
+};
+
+typedef struct ratectl_s * ratectl;
+
+// create controller starting at the most robust rate
+ratectl ratectl_create();
+
+// destroy controller
+void ratectl_destroy(ratectl _q);
+
+// rate to send the next frame at
+const ratectl_rate_s * ratectl_get(ratectl _q);
+
+// EVM reported by the receiver [dB]
+void ratectl_update(ratectl _q, float _evm);
+
+// loss event: a burst of frames was never answered
+void ratectl_loss(ratectl _q);
+
+// a frame was acknowledged
+void ratectl_ack(ratectl _q);
+
+// a block ack acknowledged _num_acked frames and nacked _num_nacked;
+// counts as one loss event when the nacks dominate, else as an ack
+void ratectl_report(ratectl      _q,
+                    unsigned int _num_acked,
+                    unsigned int _num_nacked);
+
+// fill rate with a fixed modulation and coding (not from the table)
+void ratectl_rate_init(ratectl_rate_s *  _rate,
+                       modulation_scheme _ms,
+                       fec_scheme        _fec0,
+                       fec_scheme        _fec1);
+
+// OFDM payload symbols (subcarrier uses) needed to send _payload_len
+// bytes at _rate
+float ratectl_airtime(const ratectl_rate_s * _rate, unsigned int _payload_len);
+
+#endif // __RATECTL_H__
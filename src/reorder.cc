@@ -0,0 +1,215 @@
+//
+// reorder
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include "frameheader.h"
+#include "aggregator.h"
+#include "reorder.h"
+
+// iovecs handed to the sink per call
+#define REORDER_MAX_IOV 64
+
+struct reorder_slot_s {
+    unsigned char * data;       // payload copy, grown as needed
+    unsigned int size;          // bytes allocated
+    unsigned int len;           // payload bytes
+    int aggregated;
+    int present;
+};
+
+struct reorder_s {
+    reorder_slot_s * slots;
+    unsigned int capacity;      // number of slots, power of two
+    int keep_data;
+    pthread_mutex_t mutex;      // guards slots, next and size
+    unsigned int next;          // id of the next packet due
+    unsigned int size;          // packets stored
+};
+
+// write every byte of _iov to the descriptor
+int reorder_write_fd(const struct iovec * _iov, int _iovcnt, void * _userdata)
+{
+    int fd = (int)(intptr_t)_userdata;
+    struct iovec iov[REORDER_MAX_IOV];
+    int done;
+    for (done=0; done<_iovcnt; done+=REORDER_MAX_IOV) {
+        // writev may take less than asked and modifies nothing, so work
+        // on a copy that can be advanced past a short write
+        int n = _iovcnt - done < REORDER_MAX_IOV ? _iovcnt - done : REORDER_MAX_IOV;
+        memcpy(iov, _iov + done, n*sizeof(struct iovec));
+        struct iovec * v = iov;
+        while (n > 0) {
+            ssize_t r = writev(fd, v, n);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r < 0)
+                return 0;
+            while (n > 0 && (size_t)r >= v->iov_len) {
+                r -= v->iov_len;
+                v++;
+                n--;
+            }
+            if (n > 0) {
+                v->iov_base = (char*)v->iov_base + r;
+                v->iov_len -= r;
+            }
+        }
+    }
+    return 1;
+}
+
+// create buffer
+reorder reorder_create(unsigned int _capacity, int _keep_data)
+{
+    unsigned int capacity = 1;
+    while (capacity < _capacity && capacity < (1u << 30))
+        capacity <<= 1;
+
+    reorder q = (reorder) malloc(sizeof(struct reorder_s));
+    q->slots     = (reorder_slot_s*) calloc(capacity, sizeof(reorder_slot_s));
+    q->capacity  = capacity;
+    q->keep_data = _keep_data;
+    q->next      = 0;
+    q->size      = 0;
+    pthread_mutex_init(&q->mutex, NULL);
+    return q;
+}
+
+// destroy buffer
+void reorder_destroy(reorder _q)
+{
+    unsigned int i;
+    for (i=0; i<_q->capacity; i++)
+        free(_q->slots[i].data);
+    free(_q->slots);
+    pthread_mutex_destroy(&_q->mutex);
+    free(_q);
+}
+
+// add packet
+int reorder_push(reorder               _q,
+                 unsigned int          _id,
+                 const unsigned char * _payload,
+                 unsigned int          _payload_len,
+                 int                   _aggregated)
+{
+    pthread_mutex_lock(&_q->mutex);
+    int d = frameheader_seq_diff(_id, _q->next);
+    reorder_slot_s * slot = &_q->slots[_id & (_q->capacity-1)];
+    int result;
+    if (d < 0 || (d < (int)_q->capacity && slot->present)) {
+        result = REORDER_DUPLICATE;
+    } else if (d >= (int)_q->capacity) {
+        result = REORDER_TOO_FAR;
+    } else {
+        if (_q->keep_data) {
+            if (slot->size < _payload_len) {
+                slot->data = (unsigned char*) realloc(slot->data, _payload_len);
+                slot->size = _payload_len;
+            }
+            memcpy(slot->data, _payload, _payload_len);
+        }
+        slot->len        = _payload_len;
+        slot->aggregated = _aggregated;
+        slot->present    = 1;
+        _q->size++;
+        result = REORDER_STORED;
+    }
+    pthread_mutex_unlock(&_q->mutex);
+    return result;
+}
+
+// hand packets [_first, _first+_n) to the sink, REORDER_MAX_IOV pieces
+// at a time; stops at the first failure
+static int reorder_flush(reorder      _q,
+                          unsigned int _first,
+                          unsigned int _n,
+                          reorder_sink _sink,
+                          void *       _userdata)
+{
+    struct iovec iov[REORDER_MAX_IOV];
+    int n = 0;
+    unsigned int i;
+    for (i=0; i<_n; i++) {
+        reorder_slot_s * slot = &_q->slots[(_first + i) & (_q->capacity-1)];
+        if (!slot->aggregated) {
+            if (n == REORDER_MAX_IOV) {
+                if (!_sink(iov, n, _userdata))
+                    return 0;
+                n = 0;
+            }
+            iov[n].iov_base = slot->data;
+            iov[n].iov_len  = slot->len;
+            n++;
+            continue;
+        }
+        // one piece per message, without its length prefix
+        unsigned int offset = 0;
+        const unsigned char * msg;
+        unsigned int msg_len;
+        while (aggregator_next(slot->data, slot->len, &offset, &msg, &msg_len)) {
+            if (n == REORDER_MAX_IOV) {
+                if (!_sink(iov, n, _userdata))
+                    return 0;
+                n = 0;
+            }
+            iov[n].iov_base = (void*)msg;
+            iov[n].iov_len  = msg_len;
+            n++;
+        }
+    }
+    return n == 0 || _sink(iov, n, _userdata);
+}
+
+// hand every packet now in order to the sink
+unsigned int reorder_deliver(reorder _q, reorder_sink _sink, void * _userdata)
+{
+    // find the run of packets due; while the sink reads them they stay
+    // marked present, so pushes of the same ids count as duplicates
+    pthread_mutex_lock(&_q->mutex);
+    unsigned int first = _q->next;
+    unsigned int n = 0;
+    while (n < _q->capacity && _q->slots[(first + n) & (_q->capacity-1)].present)
+        n++;
+    pthread_mutex_unlock(&_q->mutex);
+    if (n == 0)
+        return 0;
+
+    // the data is gone either way; the sink reports its own failures
+    if (_q->keep_data && _sink != NULL)
+        reorder_flush(_q, first, n, _sink, _userdata);
+
+    pthread_mutex_lock(&_q->mutex);
+    unsigned int i;
+    for (i=0; i<n; i++)
+        _q->slots[(first + i) & (_q->capacity-1)].present = 0;
+    _q->next = first + n;
+    _q->size -= n;
+    pthread_mutex_unlock(&_q->mutex);
+    return n;
+}
+
+// id of the next packet due
+unsigned int reorder_next(reorder _q)
+{
+    pthread_mutex_lock(&_q->mutex);
+    unsigned int next = _q->next;
+    pthread_mutex_unlock(&_q->mutex);
+    return next;
+}
+
+// number of packets waiting
+unsigned int reorder_size(reorder _q)
+{
+    pthread_mutex_lock(&_q->mutex);
+    unsigned int size = _q->size;
+    pthread_mutex_unlock(&_q->mutex);
+    return size;
+}
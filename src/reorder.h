@@ -0,0 +1,58 @@
+//
+// reorder
+//
+// Receive-side reassembly buffer for the UAV. Packets are kept in a
+// ring indexed by sequence number modulo the capacity until every
+// earlier packet has arrived, then handed to a sink in order, batched
+// into vectored writes. Packets already received, or already
+// delivered, are reported as duplicates and dropped. The callback
+// thread may push while another thread delivers.
+//
+
+#ifndef __REORDER_H__
+#define __REORDER_H__
+
+#include <sys/uio.h>
+
+// results of reorder_push()
+#define REORDER_STORED      0   // new packet, kept for delivery
+#define REORDER_DUPLICATE   1   // received before, dropped
+#define REORDER_TOO_FAR     2   // beyond the window, dropped unseen
+
+// consumer of in-order data; returns 0 if it failed
+typedef int (*reorder_sink)(const struct iovec * _iov,
+                            int                  _iovcnt,
+                            void *               _userdata);
+
+// sink writing to file descriptor (intptr_t)_userdata
+int reorder_write_fd(const struct iovec * _iov, int _iovcnt, void * _userdata);
+
+typedef struct reorder_s * reorder;
+
+// create buffer holding packets up to _capacity ids (rounded up to a
+// power of two) past the next one due, starting from id 0; with
+// _keep_data 0 only ids are tracked and delivery hands out nothing
+reorder reorder_create(unsigned int _capacity, int _keep_data);
+
+// destroy buffer
+void reorder_destroy(reorder _q);
+
+// add packet _id; an aggregated payload is delivered as the messages
+// packed into it. Returns REORDER_*.
+int reorder_push(reorder               _q,
+                 unsigned int          _id,
+                 const unsigned char * _payload,
+                 unsigned int          _payload_len,
+                 int                   _aggregated);
+
+// hand every packet now in order to _sink (may be NULL); returns the
+// number of packets delivered
+unsigned int reorder_deliver(reorder _q, reorder_sink _sink, void * _userdata);
+
+// id of the next packet due
+unsigned int reorder_next(reorder _q);
+
+// number of packets waiting for an earlier one
+unsigned int reorder_size(reorder _q);
+
+#endif // __REORDER_H__
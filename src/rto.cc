@@ -0,0 +1,75 @@
+//
+// rto
+//
+
+#include "rto.h"
+
+// smoothing gains and deviation multiplier of RFC 6298
+#define RTO_ALPHA 0.125f
+#define RTO_BETA  0.25f
+#define RTO_K     4.0f
+
+// keep _x within the timeout bounds
+static float rto_clamp(const rto_s * _q, float _x)
+{
+    return _x < _q->min ? _q->min : _x > _q->max ? _q->max : _x;
+}
+
+// start from timeout _initial
+void rto_init(rto_s * _q, float _initial, float _min, float _max)
+{
+    _q->srtt    = 0;
+    _q->rttvar  = 0;
+    _q->min     = _min;
+    _q->max     = _max;
+    _q->rto     = rto_clamp(_q, _initial);
+    _q->backoff = 0;
+    _q->backoff_time = 0;
+}
+
+// add a round-trip time sample
+void rto_sample(rto_s * _q, float _rtt)
+{
+    if (_q->srtt == 0) {
+        _q->srtt   = _rtt;
+        _q->rttvar = _rtt / 2;
+    } else {
+        float err = _q->srtt - _rtt;
+        _q->rttvar = (1 - RTO_BETA) * _q->rttvar + RTO_BETA * (err < 0 ? -err : err);
+        _q->srtt   = (1 - RTO_ALPHA) * _q->srtt + RTO_ALPHA * _rtt;
+    }
+    // a steady link drives rttvar to 0; keep the margin above one
+    // clock tick so the timeout does not fire on ordinary jitter
+    float margin = RTO_K * _q->rttvar;
+    _q->rto = rto_clamp(_q, _q->srtt + (margin > _q->min ? margin : _q->min));
+    _q->backoff = 0;
+}
+
+// double the timeout for a loss
+int rto_backoff(rto_s * _q, long long _sent, long long _now)
+{
+    // every frame of a lost burst times out in turn; only those sent
+    // after the last doubling say the longer timeout is still too short
+    if (_sent < _q->backoff_time)
+        return 0;
+    if (rto_get(_q) < _q->max)
+        _q->backoff++;
+    _q->backoff_time = _now;
+    return 1;
+}
+
+// retransmission timeout, with backoff
+float rto_get(const rto_s * _q)
+{
+    float x = _q->rto;
+    unsigned int i;
+    for (i=0; i<_q->backoff && x < _q->max; i++)
+        x *= 2;
+    return rto_clamp(_q, x);
+}
+
+// time to wait for a response, without backoff
+float rto_get_response(const rto_s * _q)
+{
+    return _q->srtt == 0 ? -1.0f : _q->rto;
+}
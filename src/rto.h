@@ -0,0 +1,43 @@
+//
+// rto
+//
+// Retransmission timeout estimator after RFC 6298: a smoothed
+// round-trip time and its mean deviation, fed only with samples from
+// frames acknowledged on their first transmission (Karn's rule), with
+// the timeout doubled on every loss until a fresh sample arrives.
+//
+
+#ifndef __RTO_H__
+#define __RTO_H__
+
+struct rto_s {
+    float srtt;                 // smoothed round-trip time [s], 0 until
+                                // the first sample
+    float rttvar;               // round-trip time variation [s]
+    float rto;                  // timeout before backoff [s]
+    float min;                  // bounds of the timeout [s]
+    float max;
+    unsigned int backoff;       // doublings since the last sample
+    long long backoff_time;     // when the timeout last doubled [ns]
+};
+
+// start from timeout _initial, kept within [_min,_max] and at least
+// _min above the smoothed round-trip time from then on
+void rto_init(rto_s * _q, float _initial, float _min, float _max);
+
+// add a round-trip time sample [s]
+void rto_sample(rto_s * _q, float _rtt);
+
+// a frame sent at _sent [ns] timed out at _now [ns]: double the
+// timeout, once for all frames sent under the same timeout; returns 1
+// for the first timeout of such a burst, 0 for the rest
+int rto_backoff(rto_s * _q, long long _sent, long long _now);
+
+// retransmission timeout, with backoff [s]
+float rto_get(const rto_s * _q);
+
+// time to wait for a response to the latest frame, without backoff
+// [s]; -1 until the first sample
+float rto_get_response(const rto_s * _q);
+
+#endif // __RTO_H__
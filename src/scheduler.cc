@@ -0,0 +1,119 @@
+//
+// scheduler
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "scheduler.h"
+
+// smoothing of the per-session delivery ratio
+#define SCHEDULER_RATE_ALPHA 0.1f
+
+// smoothing of the per-session throughput average (about 1/beta decisions)
+#define SCHEDULER_THROUGHPUT_BETA 0.01f
+
+// floor on the delivery ratio so a session that has failed for a while
+// is still tried now and then
+#define SCHEDULER_MIN_RATE 0.01f
+
+struct scheduler_s {
+    unsigned int num_sessions;
+    int type;
+    unsigned int last;      // session picked last
+    float * rate;           // smoothed delivery ratio
+    float * efficiency;     // bits per airtime of the last frame
+    float * throughput;     // smoothed expected bits delivered per decision
+};
+
+// create scheduler
+scheduler scheduler_create(unsigned int _num_sessions, int _type)
+{
+    scheduler q = (scheduler) malloc(sizeof(struct scheduler_s));
+    q->num_sessions = _num_sessions;
+    q->type         = _type;
+    q->last         = _num_sessions - 1;
+    q->rate         = (float*) malloc(_num_sessions*sizeof(float));
+    q->efficiency   = (float*) malloc(_num_sessions*sizeof(float));
+    q->throughput   = (float*) malloc(_num_sessions*sizeof(float));
+
+    unsigned int i;
+    for (i=0; i<_num_sessions; i++) {
+        q->rate[i]       = 1.0f;
+        q->efficiency[i] = 1.0f;
+        q->throughput[i] = 0.0f;
+    }
+    return q;
+}
+
+// destroy scheduler
+void scheduler_destroy(scheduler _q)
+{
+    free(_q->rate);
+    free(_q->efficiency);
+    free(_q->throughput);
+    free(_q);
+}
+
+// pick the next session among those ready
+int scheduler_next(scheduler _q, const int * _ready)
+{
+    int best = -1;
+    float best_metric = 0.0f;
+    float metric;
+    unsigned int i;
+    unsigned int s;
+
+    // scan starting after the last pick, so ties go round-robin
+    for (i=1; i<=_q->num_sessions; i++) {
+        s = (_q->last + i) % _q->num_sessions;
+        if (!_ready[s])
+            continue;
+        if (_q->type == SCHEDULER_ROUND_ROBIN) {
+            best = s;
+            break;
+        }
+
+        // a session that has had no airtime yet goes first
+        metric = _q->rate[s] * _q->efficiency[s] / (_q->throughput[s] + 1e-6f);
+        if (best < 0 || metric > best_metric) {
+            best = s;
+            best_metric = metric;
+        }
+    }
+
+    if (best >= 0)
+        _q->last = best;
+    return best;
+}
+
+// charge session for a frame, at the rate it is delivering
+void scheduler_charge(scheduler    _q,
+                      unsigned int _s,
+                      float        _bits,
+                      float        _airtime)
+{
+    unsigned int i;
+    for (i=0; i<_q->num_sessions; i++)
+        _q->throughput[i] *= 1.0f - SCHEDULER_THROUGHPUT_BETA;
+    _q->throughput[_s] += SCHEDULER_THROUGHPUT_BETA * _bits * _q->rate[_s];
+    if (_airtime > 0)
+        _q->efficiency[_s] = _bits / _airtime;
+}
+
+// record frame outcome
+void scheduler_report(scheduler _q, unsigned int _s, int _delivered)
+{
+    float r = (1.0f - SCHEDULER_RATE_ALPHA) * _q->rate[_s] +
+              SCHEDULER_RATE_ALPHA * (_delivered ? 1.0f : 0.0f);
+    _q->rate[_s] = r < SCHEDULER_MIN_RATE ? SCHEDULER_MIN_RATE : r;
+}
+
+// parse scheduler name
+int scheduler_str2type(const char * _str)
+{
+    if (strcmp(_str, "rr") == 0)
+        return SCHEDULER_ROUND_ROBIN;
+    if (strcmp(_str, "pf") == 0)
+        return SCHEDULER_PROPORTIONAL_FAIR;
+    return SCHEDULER_UNKNOWN;
+}
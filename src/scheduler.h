@@ -0,0 +1,46 @@
+//
+// scheduler
+//
+// Shares the base station's airtime between UAV sessions. Each decision
+// picks one session among those with a frame ready to send:
+//  - round-robin: sessions take turns.
+//  - proportional-fair: picks the session whose current rate (bits per
+//    unit of airtime times delivery ratio) is highest relative to the
+//    throughput it has had lately. Links are favoured while they are
+//    better than their own average, and no link is starved.
+//
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#define SCHEDULER_ROUND_ROBIN       0
+#define SCHEDULER_PROPORTIONAL_FAIR 1
+#define SCHEDULER_UNKNOWN          -1
+
+typedef struct scheduler_s * scheduler;
+
+// create scheduler for _num_sessions sessions
+scheduler scheduler_create(unsigned int _num_sessions, int _type);
+
+// destroy scheduler
+void scheduler_destroy(scheduler _q);
+
+// pick the next session among those with _ready[i] set; returns -1 if
+// none is ready
+int scheduler_next(scheduler _q, const int * _ready);
+
+// charge session _s for a frame of _bits occupying _airtime (any
+// consistent unit)
+void scheduler_charge(scheduler    _q,
+                      unsigned int _s,
+                      float        _bits,
+                      float        _airtime);
+
+// record whether a frame sent to session _s was delivered
+void scheduler_report(scheduler _q, unsigned int _s, int _delivered);
+
+// parse scheduler name ("rr" or "pf"); returns SCHEDULER_UNKNOWN if
+// the name is not recognized
+int scheduler_str2type(const char * _str);
+
+#endif // __SCHEDULER_H__
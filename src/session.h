@@ -0,0 +1,16 @@
+//
+// session
+//
+// The base station can serve several UAVs at once on one channel. Each
+// UAV is given a session id, and every data frame and ack carries the
+// id of the UAV it is for or from in its frame header (frameheader.h),
+// so both ends can pick out their own frames.
+//
+
+#ifndef __SESSION_H__
+#define __SESSION_H__
+
+// maximum number of UAVs one base station serves
+#define SESSION_MAX 64
+
+#endif // __SESSION_H__
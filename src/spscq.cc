@@ -0,0 +1,73 @@
+//
+// spscq
+//
+
+#include <stdlib.h>
+#include "spscq.h"
+
+struct spscq_s {
+    // written by the consumer, read by the producer
+    alignas(64) unsigned int head;
+    // written by the producer, read by the consumer
+    alignas(64) unsigned int tail;
+
+    alignas(64) unsigned int * buffer;
+    unsigned int capacity;          // power of two
+};
+
+// create queue
+spscq spscq_create(unsigned int _capacity)
+{
+    unsigned int capacity = 1;
+    while (capacity < _capacity)
+        capacity <<= 1;
+
+    spscq q = new spscq_s;
+    q->head     = 0;
+    q->tail     = 0;
+    q->capacity = capacity;
+    q->buffer   = (unsigned int*) malloc(capacity*sizeof(unsigned int));
+    return q;
+}
+
+// destroy queue
+void spscq_destroy(spscq _q)
+{
+    free(_q->buffer);
+    delete _q;
+}
+
+// add id to the back of the queue (producer only)
+int spscq_push(spscq _q, unsigned int _id)
+{
+    unsigned int tail = _q->tail;
+    unsigned int head = __atomic_load_n(&_q->head, __ATOMIC_ACQUIRE);
+    if (tail - head == _q->capacity)
+        return 0;
+
+    _q->buffer[tail & (_q->capacity-1)] = _id;
+    // publish the entry before the new tail
+    __atomic_store_n(&_q->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// take id off the front of the queue (consumer only)
+int spscq_pop(spscq _q, unsigned int * _id)
+{
+    unsigned int head = _q->head;
+    unsigned int tail = __atomic_load_n(&_q->tail, __ATOMIC_ACQUIRE);
+    if (head == tail)
+        return 0;
+
+    *_id = _q->buffer[head & (_q->capacity-1)];
+    // release the slot only after it has been read
+    __atomic_store_n(&_q->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// number of ids currently queued
+unsigned int spscq_size(spscq _q)
+{
+    return __atomic_load_n(&_q->tail, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&_q->head, __ATOMIC_ACQUIRE);
+}
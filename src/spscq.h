@@ -0,0 +1,29 @@
+//
+// spscq
+//
+// Bounded single-producer/single-consumer queue of packet ids. One
+// thread may push and one other thread may pop without taking a lock;
+// storage is allocated once at creation.
+//
+
+#ifndef __SPSCQ_H__
+#define __SPSCQ_H__
+
+typedef struct spscq_s * spscq;
+
+// create queue holding at least _capacity ids
+spscq spscq_create(unsigned int _capacity);
+
+// destroy queue
+void spscq_destroy(spscq _q);
+
+// add id to the back of the queue (producer only); returns 0 if full
+int spscq_push(spscq _q, unsigned int _id);
+
+// take id off the front of the queue (consumer only); returns 0 if empty
+int spscq_pop(spscq _q, unsigned int * _id);
+
+// number of ids currently queued (approximate while in use)
+unsigned int spscq_size(spscq _q);
+
+#endif // __SPSCQ_H__
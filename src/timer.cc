@@ -25,17 +25,100 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <sys/time.h>
+#include <time.h>
 #include "timer.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#  include <cpuid.h>
+#  include <x86intrin.h>
+#  define TIMER_HAVE_TSC 1
+#else
+#  define TIMER_HAVE_TSC 0
+#endif
+
 // tiemr data structure
 struct timer_s {
-    struct timeval tic;
-    struct timeval toc;
+    long long tic;
 
     int timer_started;
 };
 
+// timestamp counter calibration: ns = ns0 + ((tsc - tsc0) * mult) >> 32
+static int timer_tsc_enabled = 0;
+static unsigned long long timer_tsc0;
+static long long timer_tsc_ns0;
+static unsigned long long timer_tsc_mult;
+
+static long long timer_clock_ns(clockid_t _clock)
+{
+    struct timespec ts;
+    int rc = clock_gettime(_clock, &ts);
+    if (rc != 0) {
+        fprintf(stderr,"warning: timer, clock_gettime() returned invalid flag\n");
+    }
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// current time of the monotonic clock [ns]
+long long timer_now_ns()
+{
+#if TIMER_HAVE_TSC
+    if (timer_tsc_enabled) {
+        unsigned long long dt = __rdtsc() - timer_tsc0;
+        return timer_tsc_ns0 + (long long)(((unsigned __int128)dt * timer_tsc_mult) >> 32);
+    }
+#endif
+    return timer_clock_ns(CLOCK_MONOTONIC);
+}
+
+// current wall-clock time [ns since epoch]
+long long timer_wallclock_ns()
+{
+    return timer_clock_ns(CLOCK_REALTIME);
+}
+
+// calibrate the timestamp counter against CLOCK_MONOTONIC
+int timer_enable_tsc()
+{
+#if TIMER_HAVE_TSC
+    // only an invariant TSC ticks at a constant rate across power
+    // states and cores
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 8)))
+        return 0;
+
+    // count ticks over ~20 ms
+    long long ns0 = timer_clock_ns(CLOCK_MONOTONIC);
+    unsigned long long tsc0 = __rdtsc();
+    struct timespec ts = {0, 20000000};
+    nanosleep(&ts, NULL);
+    long long ns1 = timer_clock_ns(CLOCK_MONOTONIC);
+    unsigned long long tsc1 = __rdtsc();
+    if (tsc1 <= tsc0 || ns1 <= ns0)
+        return 0;
+
+    timer_tsc_mult  = ((unsigned long long)(ns1 - ns0) << 32) / (tsc1 - tsc0);
+    timer_tsc0      = tsc1;
+    timer_tsc_ns0   = ns1;
+    timer_tsc_enabled = 1;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+// reset stack timer
+void timer_ns_tic(timer_ns_s * _q)
+{
+    _q->tic = timer_now_ns();
+}
+
+// get elapsed time since 'tic' in nanoseconds
+long long timer_ns_toc(timer_ns_s * _q)
+{
+    return timer_now_ns() - _q->tic;
+}
+
 // create timer object
 timer timer_create()
 {
@@ -56,10 +139,7 @@ void timer_destroy(timer _q)
 // reset timer
 void timer_tic(timer _q)
 {
-    int rc = gettimeofday(&_q->tic, NULL);
-    if (rc != 0) {
-        fprintf(stderr,"warning: timer_tic(), gettimeofday() returned invalid flag\n");
-    }
+    _q->tic = timer_now_ns();
     _q->timer_started = 1;
 }
 
@@ -71,15 +151,7 @@ float timer_toc(timer _q)
         return 0;
     }
 
-    int rc = gettimeofday(&_q->toc, NULL);
-    if (rc != 0) {
-        fprintf(stderr,"warning: timer_toc(), gettimeofday() returned invalid flag\n");
-    }
-
     // compute execution time (in seconds)
-    float s  = (float)(_q->toc.tv_sec  - _q->tic.tv_sec);
-    float us = (float)(_q->toc.tv_usec - _q->tic.tv_usec);
-
-    return s + us*1e-6f;
+    return (float)(timer_now_ns() - _q->tic) * 1e-9f;
 }
 
@@ -43,5 +43,33 @@ void timer_tic(timer _q);
 // get elapsed time since 'tic' in seconds
 float timer_toc(timer _q);
 
+//
+// nanosecond monotonic clock
+//
+
+// current time of the monotonic clock [ns]; unaffected by wall-clock
+// adjustments, so differences between readings are always valid
+long long timer_now_ns();
+
+// current wall-clock time [ns since epoch]
+long long timer_wallclock_ns();
+
+// read the clock from the CPU timestamp counter instead of the
+// kernel, after calibrating it against CLOCK_MONOTONIC; returns 1 if
+// the CPU has an invariant TSC and the fast path is now in use (call
+// before starting other threads)
+int timer_enable_tsc();
+
+// allocation-free timer that can live on the stack or in a struct
+struct timer_ns_s {
+    long long tic;
+};
+
+// reset stack timer
+void timer_ns_tic(timer_ns_s * _q);
+
+// get elapsed time since 'tic' in nanoseconds
+long long timer_ns_toc(timer_ns_s * _q);
+
 #endif // __TIMER_H__
 
@@ -0,0 +1,231 @@
+//
+// timerwheel
+//
+
+#include <stdlib.h>
+#include <math.h>
+#include "timer.h"
+#include "timerwheel.h"
+
+#define TIMERWHEEL_IDLE     0
+#define TIMERWHEEL_ARMED    1
+#define TIMERWHEEL_EXPIRED  2
+
+#define TIMERWHEEL_NONE     (-1)
+
+struct timerwheel_s {
+    float tick;                     // resolution [seconds]
+    unsigned int num_slots;
+    unsigned int capacity;          // power of two
+    timer clock;                    // started at creation
+    unsigned long long now;         // last tick processed
+
+    int * slots;                    // head of list per wheel slot
+
+    // intrusive list entries, one per timer
+    unsigned int * id;
+    unsigned long long * deadline;  // absolute tick of expiry
+    int * next;
+    int * prev;
+    int * state;
+
+    int expired_head;               // expired timers, in expiry order
+    int expired_tail;
+    unsigned int size;
+};
+
+// remove entry from whichever list it is on
+static void timerwheel_unlink(timerwheel _q, int _i)
+{
+    int * head;
+    if (_q->state[_i] == TIMERWHEEL_ARMED)
+        head = &_q->slots[_q->deadline[_i] % _q->num_slots];
+    else if (_q->state[_i] == TIMERWHEEL_EXPIRED)
+        head = &_q->expired_head;
+    else
+        return;
+
+    if (_q->prev[_i] != TIMERWHEEL_NONE) _q->next[_q->prev[_i]] = _q->next[_i];
+    else                                 *head = _q->next[_i];
+    if (_q->next[_i] != TIMERWHEEL_NONE) _q->prev[_q->next[_i]] = _q->prev[_i];
+    else if (_q->state[_i] == TIMERWHEEL_EXPIRED) _q->expired_tail = _q->prev[_i];
+
+    _q->state[_i] = TIMERWHEEL_IDLE;
+    _q->size--;
+}
+
+// move entry onto the tail of the expired list
+static void timerwheel_expire(timerwheel _q, int _i)
+{
+    timerwheel_unlink(_q, _i);
+    _q->next[_i] = TIMERWHEEL_NONE;
+    _q->prev[_i] = _q->expired_tail;
+    if (_q->expired_tail != TIMERWHEEL_NONE) _q->next[_q->expired_tail] = _i;
+    else                                     _q->expired_head = _i;
+    _q->expired_tail = _i;
+    _q->state[_i] = TIMERWHEEL_EXPIRED;
+    _q->size++;
+}
+
+// create timer wheel
+timerwheel timerwheel_create(float        _tick,
+                             unsigned int _num_slots,
+                             unsigned int _capacity)
+{
+    unsigned int capacity = 1;
+    while (capacity < _capacity)
+        capacity <<= 1;
+
+    timerwheel q = (timerwheel) malloc(sizeof(struct timerwheel_s));
+    q->tick      = _tick;
+    q->num_slots = _num_slots > 0 ? _num_slots : 1;
+    q->capacity  = capacity;
+    q->now       = 0;
+    q->size      = 0;
+    q->expired_head = TIMERWHEEL_NONE;
+    q->expired_tail = TIMERWHEEL_NONE;
+
+    q->slots    = (int*) malloc(q->num_slots*sizeof(int));
+    q->id       = (unsigned int*) malloc(capacity*sizeof(unsigned int));
+    q->deadline = (unsigned long long*) malloc(capacity*sizeof(unsigned long long));
+    q->next     = (int*) malloc(capacity*sizeof(int));
+    q->prev     = (int*) malloc(capacity*sizeof(int));
+    q->state    = (int*) malloc(capacity*sizeof(int));
+
+    unsigned int i;
+    for (i=0; i<q->num_slots; i++)
+        q->slots[i] = TIMERWHEEL_NONE;
+    for (i=0; i<capacity; i++)
+        q->state[i] = TIMERWHEEL_IDLE;
+
+    q->clock = timer_create();
+    timer_tic(q->clock);
+    return q;
+}
+
+// destroy timer wheel
+void timerwheel_destroy(timerwheel _q)
+{
+    timer_destroy(_q->clock);
+    free(_q->slots);
+    free(_q->id);
+    free(_q->deadline);
+    free(_q->next);
+    free(_q->prev);
+    free(_q->state);
+    free(_q);
+}
+
+// arm (or re-arm) timer _id to expire after _delay seconds
+void timerwheel_schedule(timerwheel _q, unsigned int _id, float _delay)
+{
+    int i = _id & (_q->capacity-1);
+    timerwheel_unlink(_q, i);
+
+    // deadlines are measured from the last tick processed, rounded up
+    // so a timer never fires early
+    unsigned long long ticks = (unsigned long long) ceilf(_delay / _q->tick);
+    if (ticks == 0)
+        ticks = 1;
+
+    _q->id[i]       = _id;
+    _q->deadline[i] = _q->now + ticks;
+    _q->state[i]    = TIMERWHEEL_ARMED;
+
+    int * head = &_q->slots[_q->deadline[i] % _q->num_slots];
+    _q->prev[i] = TIMERWHEEL_NONE;
+    _q->next[i] = *head;
+    if (*head != TIMERWHEEL_NONE)
+        _q->prev[*head] = i;
+    *head = i;
+    _q->size++;
+}
+
+// disarm timer _id, if armed
+void timerwheel_cancel(timerwheel _q, unsigned int _id)
+{
+    int i = _id & (_q->capacity-1);
+    if (_q->state[i] != TIMERWHEEL_IDLE && _q->id[i] == _id)
+        timerwheel_unlink(_q, i);
+}
+
+// number of timers armed or expired but not yet popped
+unsigned int timerwheel_size(timerwheel _q)
+{
+    return _q->size;
+}
+
+// read the clock once and expire every timer that is due
+unsigned int timerwheel_advance(timerwheel _q)
+{
+    unsigned long long t = (unsigned long long)(timer_toc(_q->clock) / _q->tick);
+    if (t <= _q->now)
+        return 0;
+
+    // nothing armed: just move the wheel forward
+    if (_q->size == 0) {
+        _q->now = t;
+        return 0;
+    }
+
+    // visit each slot passed since the last call, at most once around
+    unsigned long long n = t - _q->now;
+    if (n > _q->num_slots)
+        n = _q->num_slots;
+
+    unsigned int num_expired = 0;
+    unsigned long long k;
+    for (k=1; k<=n; k++) {
+        int i = _q->slots[(_q->now + k) % _q->num_slots];
+        while (i != TIMERWHEEL_NONE) {
+            int next = _q->next[i];
+            // entries further than one turn away stay for a later lap
+            if (_q->deadline[i] <= t) {
+                timerwheel_expire(_q, i);
+                num_expired++;
+            }
+            i = next;
+        }
+    }
+    _q->now = t;
+    return num_expired;
+}
+
+// time until the earliest armed timer is due
+float timerwheel_next_timeout(timerwheel _q)
+{
+    if (_q->expired_head != TIMERWHEEL_NONE)
+        return 0.0f;
+    if (_q->size == 0)
+        return -1.0f;
+
+    // walk forward from the current tick; an entry due on this lap is
+    // the earliest there can be, otherwise take the smallest deadline
+    // seen on a later lap
+    unsigned long long due = 0;
+    unsigned long long k;
+    for (k=1; k<=_q->num_slots; k++) {
+        int i = _q->slots[(_q->now + k) % _q->num_slots];
+        for ( ; i != TIMERWHEEL_NONE; i = _q->next[i]) {
+            if (due == 0 || _q->deadline[i] < due)
+                due = _q->deadline[i];
+        }
+        if (due == _q->now + k)
+            break;
+    }
+
+    float t = due*_q->tick - timer_toc(_q->clock);
+    return t > 0.0f ? t : 0.0f;
+}
+
+// pop the next expired timer
+int timerwheel_pop(timerwheel _q, unsigned int * _id)
+{
+    int i = _q->expired_head;
+    if (i == TIMERWHEEL_NONE)
+        return 0;
+
+    *_id = _q->id[i];
+    timerwheel_unlink(_q, i);
+    return 1;
+}
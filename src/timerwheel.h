@@ -0,0 +1,46 @@
+//
+// timerwheel
+//
+// Hashed timing wheel for retransmission deadlines. Each timer is
+// identified by an id; ids equal modulo the capacity share a slot, so
+// the capacity must cover every id that can be armed at once.
+//
+
+#ifndef __TIMERWHEEL_H__
+#define __TIMERWHEEL_H__
+
+typedef struct timerwheel_s * timerwheel;
+
+// create timer wheel
+//  _tick       : wheel resolution [seconds]
+//  _num_slots  : number of wheel slots
+//  _capacity   : number of timers that can be armed at once
+timerwheel timerwheel_create(float        _tick,
+                             unsigned int _num_slots,
+                             unsigned int _capacity);
+
+// destroy timer wheel
+void timerwheel_destroy(timerwheel _q);
+
+// arm (or re-arm) timer _id to expire _delay seconds after the last
+// call to timerwheel_advance()
+void timerwheel_schedule(timerwheel _q, unsigned int _id, float _delay);
+
+// disarm timer _id, if armed
+void timerwheel_cancel(timerwheel _q, unsigned int _id);
+
+// number of timers armed or expired but not yet popped
+unsigned int timerwheel_size(timerwheel _q);
+
+// read the clock once and move every timer that is due to the expired
+// list; returns the number of timers that expired
+unsigned int timerwheel_advance(timerwheel _q);
+
+// time until the earliest armed timer is due [seconds]; 0 if expired
+// timers are waiting to be popped, -1 if no timers are armed
+float timerwheel_next_timeout(timerwheel _q);
+
+// pop the next expired timer; returns 0 when none are left
+int timerwheel_pop(timerwheel _q, unsigned int * _id);
+
+#endif // __TIMERWHEEL_H__
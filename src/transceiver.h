@@ -0,0 +1,109 @@
+//
+// transceiver
+//
+// Radio interface used by the base station and UAV protocol code. It
+// mirrors the parts of liquid-usrp's ofdmtxrx the protocol needs, so
+// the same code runs over real USRPs (usrp_transceiver) or over the
+// in-process channel emulator (emulated_transceiver). Received frames
+// are delivered to the framesync_callback given at construction, on
+// the transceiver's receive thread.
+//
+
+#ifndef __TRANSCEIVER_H__
+#define __TRANSCEIVER_H__
+
+#include <complex>
+#include <liquid/liquid.h>
+
+class transceiver {
+public:
+    virtual ~transceiver() {}
+
+    // transmitter properties
+    virtual void set_tx_freq(float _tx_freq) = 0;
+    virtual void set_tx_rate(float _tx_rate) = 0;
+    virtual void set_tx_gain_soft(float _tx_gain_soft) = 0;
+    virtual void set_tx_gain_uhd(float _tx_gain_uhd) = 0;
+
+    // encode, modulate and send one frame
+    virtual void transmit_packet(unsigned char *   _header,
+                                 unsigned char *   _payload,
+                                 unsigned int      _payload_len,
+                                 modulation_scheme _mod,
+                                 fec_scheme        _fec0,
+                                 fec_scheme        _fec1) = 0;
+
+    // send a frame that may be sent again under the same _key. A
+    // transceiver with a frame cache keeps the frame's samples, so that
+    // a resend with the same payload and rate only re-encodes what the
+    // new header changes; others encode every frame in full.
+    virtual void transmit_cached_packet(unsigned long long _key,
+                                        unsigned char *    _header,
+                                        unsigned char *    _payload,
+                                        unsigned int       _payload_len,
+                                        modulation_scheme  _mod,
+                                        fec_scheme         _fec0,
+                                        fec_scheme         _fec1)
+    {
+        transmit_packet(_header, _payload, _payload_len, _mod, _fec0, _fec1);
+    }
+
+    // send as transmit_cached_packet() a frame whose payload stays valid
+    // and unchanged until the transceiver is destroyed, so a transceiver
+    // that queues frames may keep the pointer rather than a copy
+    virtual void transmit_borrowed_packet(unsigned long long _key,
+                                          unsigned char *    _header,
+                                          unsigned char *    _payload,
+                                          unsigned int       _payload_len,
+                                          modulation_scheme  _mod,
+                                          fec_scheme         _fec0,
+                                          fec_scheme         _fec1)
+    {
+        transmit_cached_packet(_key, _header, _payload, _payload_len, _mod, _fec0, _fec1);
+    }
+
+    // the frame sent under _key will not be sent again (from any thread)
+    virtual void release_cached_packet(unsigned long long _key) {}
+
+    // a frame encoded ahead of being sent, see encode_packet()
+    struct encoded_frame {
+        virtual ~encoded_frame() {}
+    };
+
+    // encode and modulate a frame without sending it, under _key if
+    // _cached as with transmit_cached_packet(), so that several frames
+    // can be encoded at once on different threads. Returns NULL if the
+    // transceiver can only encode a frame as it sends it.
+    virtual encoded_frame * encode_packet(bool               _cached,
+                                          unsigned long long _key,
+                                          unsigned char *    _header,
+                                          unsigned char *    _payload,
+                                          unsigned int       _payload_len,
+                                          modulation_scheme  _mod,
+                                          fec_scheme         _fec0,
+                                          fec_scheme         _fec1)
+    {
+        return NULL;
+    }
+
+    // send and free a frame returned by encode_packet()
+    virtual void transmit_encoded(encoded_frame * _frame) { delete _frame; }
+
+    // can transmit_packet() be called without blocking, and wait until
+    // it can; transceivers that send synchronously are always ready
+    virtual bool tx_ready() { return true; }
+    virtual void wait_tx_ready() {}
+
+    // receiver properties
+    virtual void set_rx_freq(float _rx_freq) = 0;
+    virtual void set_rx_rate(float _rx_rate) = 0;
+    virtual void set_rx_gain_uhd(float _rx_gain_uhd) = 0;
+
+    // start/stop delivering received frames to the callback
+    virtual void start_rx() = 0;
+    virtual void stop_rx() = 0;
+
+    virtual void debug_enable() {}
+};
+
+#endif // __TRANSCEIVER_H__
@@ -0,0 +1,237 @@
+//
+// txpipeline
+//
+
+#include <string.h>
+#include "txpipeline.h"
+
+pipelined_transceiver::pipelined_transceiver(transceiver * _txcvr,
+                                             unsigned int  _depth,
+                                             unsigned int  _num_workers) :
+    txcvr(_txcvr),
+    frames(_depth > 0 ? _depth : 1),
+    head(0),
+    size(0),
+    running(true),
+    workers(_num_workers)
+{
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&not_empty, NULL);
+    pthread_cond_init(&not_full, NULL);
+    pthread_cond_init(&queued, NULL);
+    pthread_create(&tx_process, NULL, tx_thread, (void*)this);
+    unsigned int i;
+    for (i=0; i<workers.size(); i++)
+        pthread_create(&workers[i], NULL, worker_thread, (void*)this);
+}
+
+pipelined_transceiver::~pipelined_transceiver()
+{
+    pthread_mutex_lock(&mutex);
+    running = false;
+    pthread_cond_signal(&not_empty);
+    pthread_cond_broadcast(&queued);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(tx_process, NULL);
+    unsigned int i;
+    for (i=0; i<workers.size(); i++)
+        pthread_join(workers[i], NULL);
+
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&not_empty);
+    pthread_cond_destroy(&not_full);
+    pthread_cond_destroy(&queued);
+}
+
+void pipelined_transceiver::set_tx_freq(float _tx_freq)           { txcvr->set_tx_freq(_tx_freq); }
+void pipelined_transceiver::set_tx_rate(float _tx_rate)           { txcvr->set_tx_rate(_tx_rate); }
+void pipelined_transceiver::set_tx_gain_soft(float _tx_gain_soft) { txcvr->set_tx_gain_soft(_tx_gain_soft); }
+void pipelined_transceiver::set_tx_gain_uhd(float _tx_gain_uhd)   { txcvr->set_tx_gain_uhd(_tx_gain_uhd); }
+
+// queue one frame, waiting while the queue is full
+void pipelined_transceiver::transmit_packet(unsigned char *   _header,
+                                            unsigned char *   _payload,
+                                            unsigned int      _payload_len,
+                                            modulation_scheme _mod,
+                                            fec_scheme        _fec0,
+                                            fec_scheme        _fec1)
+{
+    push(false, false, 0, _header, _payload, _payload_len, _mod, _fec0, _fec1);
+}
+
+// queue one frame to be sent under _key, waiting while the queue is full
+void pipelined_transceiver::transmit_cached_packet(unsigned long long _key,
+                                                   unsigned char *    _header,
+                                                   unsigned char *    _payload,
+                                                   unsigned int       _payload_len,
+                                                   modulation_scheme  _mod,
+                                                   fec_scheme         _fec0,
+                                                   fec_scheme         _fec1)
+{
+    push(true, false, _key, _header, _payload, _payload_len, _mod, _fec0, _fec1);
+}
+
+// queue one frame to be sent under _key, keeping only a pointer to its
+// payload, waiting while the queue is full
+void pipelined_transceiver::transmit_borrowed_packet(unsigned long long _key,
+                                                     unsigned char *    _header,
+                                                     unsigned char *    _payload,
+                                                     unsigned int       _payload_len,
+                                                     modulation_scheme  _mod,
+                                                     fec_scheme         _fec0,
+                                                     fec_scheme         _fec1)
+{
+    push(true, true, _key, _header, _payload, _payload_len, _mod, _fec0, _fec1);
+}
+
+// passed straight on: a frame still queued under _key is cached again
+// when it goes out, and is evicted in time like any other
+void pipelined_transceiver::release_cached_packet(unsigned long long _key)
+{
+    txcvr->release_cached_packet(_key);
+}
+
+// copy a frame into the queue, waiting while it is full
+void pipelined_transceiver::push(bool               _cached,
+                                 bool               _borrowed,
+                                 unsigned long long _key,
+                                 unsigned char *    _header,
+                                 unsigned char *    _payload,
+                                 unsigned int       _payload_len,
+                                 modulation_scheme  _mod,
+                                 fec_scheme         _fec0,
+                                 fec_scheme         _fec1)
+{
+    pthread_mutex_lock(&mutex);
+    while (size == frames.size())
+        pthread_cond_wait(&not_full, &mutex);
+    frame_s * f = &frames[(head + size) % frames.size()];
+    pthread_mutex_unlock(&mutex);
+
+    // the slot is ours until it is counted in size, so it is filled
+    // without the lock
+    f->state   = FRAME_QUEUED;
+    f->encoded = NULL;
+    f->cached  = _cached;
+    f->key     = _key;
+    memcpy(f->header, _header, 8);
+    if (_borrowed || _payload_len == 0) {
+        f->data = _payload;
+    } else {
+        // the caller may reuse its buffer (an acked packet's slot) as
+        // soon as this returns
+        if (f->payload.size() < _payload_len)
+            f->payload.resize(_payload_len);
+        memcpy(&f->payload[0], _payload, _payload_len);
+        f->data = &f->payload[0];
+    }
+    f->payload_len = _payload_len;
+    f->mod  = _mod;
+    f->fec0 = _fec0;
+    f->fec1 = _fec1;
+
+    pthread_mutex_lock(&mutex);
+    size++;
+    if (workers.empty())
+        pthread_cond_signal(&not_empty);
+    else
+        pthread_cond_signal(&queued);
+    pthread_mutex_unlock(&mutex);
+}
+
+// can a frame be queued without waiting?
+bool pipelined_transceiver::tx_ready()
+{
+    pthread_mutex_lock(&mutex);
+    bool ready = size < frames.size();
+    pthread_mutex_unlock(&mutex);
+    return ready;
+}
+
+// wait until a frame can be queued without waiting
+void pipelined_transceiver::wait_tx_ready()
+{
+    pthread_mutex_lock(&mutex);
+    while (size == frames.size())
+        pthread_cond_wait(&not_full, &mutex);
+    pthread_mutex_unlock(&mutex);
+}
+
+void pipelined_transceiver::set_rx_freq(float _rx_freq)           { txcvr->set_rx_freq(_rx_freq); }
+void pipelined_transceiver::set_rx_rate(float _rx_rate)           { txcvr->set_rx_rate(_rx_rate); }
+void pipelined_transceiver::set_rx_gain_uhd(float _rx_gain_uhd)   { txcvr->set_rx_gain_uhd(_rx_gain_uhd); }
+
+void pipelined_transceiver::start_rx()     { txcvr->start_rx(); }
+void pipelined_transceiver::stop_rx()      { txcvr->stop_rx(); }
+void pipelined_transceiver::debug_enable() { txcvr->debug_enable(); }
+
+// send the oldest frame once it can go out, in queue order
+void * pipelined_transceiver::tx_thread(void * _arg)
+{
+    pipelined_transceiver * q = (pipelined_transceiver*) _arg;
+
+    pthread_mutex_lock(&q->mutex);
+    while (q->running || q->size > 0) {
+        frame_s * f = &q->frames[q->head];
+        if (q->size == 0 || (!q->workers.empty() && f->state != FRAME_ENCODED)) {
+            pthread_cond_wait(&q->not_empty, &q->mutex);
+            continue;
+        }
+
+        // send without the lock so the next frame can be queued
+        // meanwhile; the slot is freed only once it has gone out
+        pthread_mutex_unlock(&q->mutex);
+        if (f->encoded != NULL)
+            q->txcvr->transmit_encoded(f->encoded);
+        else if (f->cached)
+            q->txcvr->transmit_cached_packet(f->key, f->header, f->data, f->payload_len, f->mod, f->fec0, f->fec1);
+        else
+            q->txcvr->transmit_packet(f->header, f->data, f->payload_len, f->mod, f->fec0, f->fec1);
+        pthread_mutex_lock(&q->mutex);
+
+        f->encoded = NULL;
+        q->head = (q->head + 1) % q->frames.size();
+        q->size--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return NULL;
+}
+
+// encode the oldest frame no other worker has taken
+void * pipelined_transceiver::worker_thread(void * _arg)
+{
+    pipelined_transceiver * q = (pipelined_transceiver*) _arg;
+    unsigned int i;
+
+    pthread_mutex_lock(&q->mutex);
+    while (1) {
+        frame_s * f = NULL;
+        for (i=0; i<q->size && f == NULL; i++) {
+            frame_s * g = &q->frames[(q->head + i) % q->frames.size()];
+            if (g->state == FRAME_QUEUED)
+                f = g;
+        }
+        if (f == NULL) {
+            if (!q->running)
+                break;
+            pthread_cond_wait(&q->queued, &q->mutex);
+            continue;
+        }
+        f->state = FRAME_ENCODING;
+
+        // the slot stays queued until it is sent, so it is read
+        // without the lock
+        pthread_mutex_unlock(&q->mutex);
+        encoded_frame * encoded = q->txcvr->encode_packet(f->cached, f->key, f->header, f->data,
+                                                          f->payload_len, f->mod, f->fec0, f->fec1);
+        pthread_mutex_lock(&q->mutex);
+
+        f->encoded = encoded;
+        f->state = FRAME_ENCODED;
+        if (f == &q->frames[q->head])
+            pthread_cond_signal(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return NULL;
+}
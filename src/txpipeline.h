@@ -0,0 +1,139 @@
+//
+// txpipeline
+//
+// transceiver that hands frames to a dedicated transmit thread. The
+// caller's transmit_packet() only copies the frame into a bounded
+// queue (transmit_borrowed_packet() queues just the payload pointer),
+// so encoding, modulation and buffer submission on the wrapped
+// transceiver overlap with the protocol work that picks the next
+// frame, and the radio is kept busy back to back. Once the queue is
+// full, transmit_packet() blocks; protocol code can call
+// wait_tx_ready() first to wait for room without holding its own
+// locks. Everything but transmit_packet() is forwarded to the wrapped
+// transceiver directly, so configure it before the first frame.
+//
+// With encode workers, frames further back in the queue are encoded
+// and modulated on a pool of threads while earlier ones go out, and
+// the transmit thread sends them in queue order, so the send rate is
+// set by the radio rather than by one core's encoding speed. This
+// needs a transceiver that can encode ahead (encode_packet()); with
+// any other the workers stay idle.
+//
+
+#ifndef __TXPIPELINE_H__
+#define __TXPIPELINE_H__
+
+#include <vector>
+#include <pthread.h>
+#include "transceiver.h"
+
+class pipelined_transceiver : public transceiver {
+public:
+    // queue up to _depth frames in front of _txcvr, counting the one
+    // being sent, and encode them ahead on _num_workers threads (0 to
+    // encode each frame as it is sent); _txcvr must outlive the
+    // pipeline
+    pipelined_transceiver(transceiver * _txcvr,
+                          unsigned int  _depth,
+                          unsigned int  _num_workers);
+
+    // send the frames still queued, then stop the threads
+    ~pipelined_transceiver();
+
+    void set_tx_freq(float _tx_freq);
+    void set_tx_rate(float _tx_rate);
+    void set_tx_gain_soft(float _tx_gain_soft);
+    void set_tx_gain_uhd(float _tx_gain_uhd);
+
+    // queue one frame, waiting while the queue is full
+    void transmit_packet(unsigned char *   _header,
+                         unsigned char *   _payload,
+                         unsigned int      _payload_len,
+                         modulation_scheme _mod,
+                         fec_scheme        _fec0,
+                         fec_scheme        _fec1);
+
+    // queue one frame to be sent under _key, waiting while the queue
+    // is full
+    void transmit_cached_packet(unsigned long long _key,
+                                unsigned char *    _header,
+                                unsigned char *    _payload,
+                                unsigned int       _payload_len,
+                                modulation_scheme  _mod,
+                                fec_scheme         _fec0,
+                                fec_scheme         _fec1);
+
+    // queue one frame to be sent under _key without copying its payload,
+    // waiting while the queue is full
+    void transmit_borrowed_packet(unsigned long long _key,
+                                  unsigned char *    _header,
+                                  unsigned char *    _payload,
+                                  unsigned int       _payload_len,
+                                  modulation_scheme  _mod,
+                                  fec_scheme         _fec0,
+                                  fec_scheme         _fec1);
+    void release_cached_packet(unsigned long long _key);
+
+    bool tx_ready();
+    void wait_tx_ready();
+
+    void set_rx_freq(float _rx_freq);
+    void set_rx_rate(float _rx_rate);
+    void set_rx_gain_uhd(float _rx_gain_uhd);
+
+    void start_rx();
+    void stop_rx();
+
+    void debug_enable();
+
+private:
+    // copy a frame (but for a _borrowed payload) into the queue, waiting
+    // while it is full
+    void push(bool               _cached,
+              bool               _borrowed,
+              unsigned long long _key,
+              unsigned char *    _header,
+              unsigned char *    _payload,
+              unsigned int       _payload_len,
+              modulation_scheme  _mod,
+              fec_scheme         _fec0,
+              fec_scheme         _fec1);
+
+    static void * tx_thread(void * _arg);
+    static void * worker_thread(void * _arg);
+
+    // frame states; frames are queued, possibly encoded ahead, and sent
+    // in order
+    enum { FRAME_QUEUED, FRAME_ENCODING, FRAME_ENCODED };
+
+    struct frame_s {
+        int state;
+        encoded_frame * encoded;    // NULL unless encoded ahead
+        bool cached;            // sent with transmit_cached_packet()
+        unsigned long long key;
+        unsigned char header[8];
+        std::vector<unsigned char> payload;
+        unsigned char * data;   // payload: borrowed, or the slot's copy
+        unsigned int payload_len;
+        modulation_scheme mod;
+        fec_scheme fec0;
+        fec_scheme fec1;
+    };
+
+    transceiver * txcvr;
+
+    // ring of queued frames; slots keep their payload buffer
+    std::vector<frame_s> frames;
+    unsigned int head;          // oldest queued frame
+    unsigned int size;          // number of frames queued
+    bool running;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;   // the oldest frame can be sent
+    pthread_cond_t not_full;
+    pthread_cond_t queued;      // a frame is waiting for a worker
+    pthread_t tx_process;
+    std::vector<pthread_t> workers;
+};
+
+#endif // __TXPIPELINE_H__
@@ -0,0 +1,507 @@
+//
+// uavnode
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include "timer.h"
+#include "frameheader.h"
+#include "blockack.h"
+#include "event.h"
+#include "spscq.h"
+#include "harq.h"
+#include "aggregator.h"
+#include "erasure.h"
+#include "uavnode.h"
+
+struct uavnode_s {
+	uavnode_props_s props;
+	evlog event_log;
+
+	// ids handed from the callback to the main loop
+	spscq acks_to_send;
+	spscq nacks_to_send;
+
+	// raised by the callback whenever an ack or nack is queued
+	event ack_event;
+	int running;
+
+	// link quality of the latest frame addressed to us, reported back
+	// in block acks (written by the callback, read by the main loop)
+	float evm;
+	float rssi;
+
+	// soft copies of failed payloads, NULL without harq
+	harq harq_buffers;
+
+	// recent payloads to rebuild lost ones from repair frames, NULL
+	// without erasure coding
+	erasure_decoder repair_code;
+
+	// received data on its way to the sink in order
+	reorder rx_buffer;
+	int output_fd;                      // -1 without an output file
+	reorder_sink sink;
+	void * sink_userdata;
+	bool sink_failed;
+
+	// quality of every frame addressed to us
+	histogram_s evm_histogram;
+	histogram_s rssi_histogram;
+
+	timer rx_timer;
+	timer packet_arrival_timer;
+	bool first_packet_arrived;
+	float total_elapsed_time;
+	// data counters, bumped atomically so stats can be read while running
+	unsigned int num_frames_detected;
+	unsigned int num_valid_headers_received;
+	unsigned int num_valid_packets_received;
+	unsigned int num_valid_bytes_received;
+	unsigned int num_duplicates_received;
+	unsigned int num_unique_bytes_received;
+	unsigned int num_harq_recovered;
+	unsigned int num_erasure_recovered;
+	unsigned int num_messages_received;
+	unsigned int num_acks_sent;
+	unsigned int num_responses_dropped;
+};
+
+// uav defaults
+void uavnode_props_init_default(uavnode_props_s * _props)
+{
+	_props->session = 0;
+	_props->rx_timeout = 3.0;
+	_props->harq_buffers = 0;
+	_props->reorder_window = 4096;
+	_props->erasure_window = 0;
+	_props->output = NULL;
+	_props->sink = NULL;
+	_props->sink_userdata = NULL;
+	_props->verbose = false;
+}
+
+// create uav
+uavnode uavnode_create(uavnode_props_s * _props, evlog _log)
+{
+	uavnode q = (uavnode) malloc(sizeof(struct uavnode_s));
+	q->props = *_props;
+	q->event_log = _log;
+
+	// every packet of the window may be answered before the transmit
+	// loop drains the queues, duplicates and rebuilt packets included
+	q->acks_to_send = spscq_create(2*q->props.reorder_window);
+	q->nacks_to_send = spscq_create(2*q->props.reorder_window);
+	q->ack_event = event_create();
+	q->running = 0;
+	q->evm = 0;
+	q->rssi = 0;
+	q->harq_buffers = q->props.harq_buffers > 0 ? harq_create(q->props.harq_buffers) : NULL;
+	q->repair_code = q->props.erasure_window > 0 ? erasure_decoder_create(q->props.erasure_window) : NULL;
+	q->output_fd = -1;
+	q->sink = q->props.sink;
+	q->sink_userdata = q->props.sink_userdata;
+	if(q->props.output != NULL)
+	{
+		q->output_fd = open(q->props.output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(q->output_fd < 0)
+		{
+			fprintf(stderr,"error: uavnode_create(), could not open '%s' for writing\n", q->props.output);
+			exit(1);
+		}
+		q->sink = reorder_write_fd;
+		q->sink_userdata = (void*)(intptr_t)q->output_fd;
+	}
+	q->sink_failed = false;
+	// payloads are only kept if something wants them
+	q->rx_buffer = reorder_create(q->props.reorder_window, q->sink != NULL);
+	histogram_init(&q->evm_histogram, -40.0f, 0.0f, 0);
+	histogram_init(&q->rssi_histogram, -100.0f, 20.0f, 0);
+
+	q->rx_timer = timer_create();
+	q->packet_arrival_timer = timer_create();
+	q->first_packet_arrived = false;
+	q->total_elapsed_time = 0;
+
+	// reset counters
+	q->num_frames_detected=0;
+	q->num_valid_headers_received=0;
+	q->num_valid_packets_received=0;
+	q->num_valid_bytes_received=0;
+	q->num_duplicates_received=0;
+	q->num_unique_bytes_received=0;
+	q->num_harq_recovered=0;
+	q->num_erasure_recovered=0;
+	q->num_messages_received=0;
+	q->num_acks_sent=0;
+	q->num_responses_dropped=0;
+	return q;
+}
+
+// destroy uav
+void uavnode_destroy(uavnode _q)
+{
+	timer_destroy(_q->rx_timer);
+	timer_destroy(_q->packet_arrival_timer);
+	event_destroy(_q->ack_event);
+	if(_q->harq_buffers != NULL)
+		harq_destroy(_q->harq_buffers);
+	if(_q->repair_code != NULL)
+		erasure_decoder_destroy(_q->repair_code);
+	reorder_destroy(_q->rx_buffer);
+	if(_q->output_fd >= 0)
+		close(_q->output_fd);
+	spscq_destroy(_q->acks_to_send);
+	spscq_destroy(_q->nacks_to_send);
+	free(_q);
+}
+
+// transmit a coalesced block ack back to the base station
+static void transmit_block_ack(uavnode _q, transceiver * _txcvr, blockack_s * _ba)
+{
+	unsigned char header[FRAMEHEADER_LEN];
+	unsigned char payload[BLOCKACK_MAX_PAYLOAD_LEN];
+	float evm;
+	float rssi;
+	__atomic_load(&_q->evm, &evm, __ATOMIC_RELAXED);
+	__atomic_load(&_q->rssi, &rssi, __ATOMIC_RELAXED);
+	blockack_set_link_quality(_ba, evm, rssi);
+	unsigned int n = blockack_encode(_ba, _q->props.session, header, payload);
+	_txcvr->transmit_packet(header, payload, n, LIQUID_MODEM_BPSK, LIQUID_FEC_CONV_V29P23, LIQUID_FEC_RS_M8);
+	__atomic_add_fetch(&_q->num_acks_sent, 1, __ATOMIC_RELAXED);
+}
+
+// add packet to the pending block ack, sending it first if the packet
+// does not fit
+static void queue_block_ack(uavnode _q, transceiver * _txcvr, blockack_s * _ba, unsigned int _id, int _ack)
+{
+	if(blockack_empty(_ba))
+		blockack_init(_ba, _id);
+	if(!blockack_add(_ba, _id, _ack))
+	{
+		transmit_block_ack(_q, _txcvr, _ba);
+		blockack_init(_ba, _id);
+		blockack_add(_ba, _id, _ack);
+	}
+}
+
+// queue an ack or nack for the transmit loop; one that does not fit is
+// counted and left to the base station's retransmission timeout
+static void uavnode_respond(uavnode _q, spscq _queue, unsigned int _id)
+{
+	if(!spscq_push(_queue, _id))
+		__atomic_add_fetch(&_q->num_responses_dropped, 1, __ATOMIC_RELAXED);
+	event_signal(_q->ack_event);
+}
+
+// hand an intact payload to the reorder buffer and queue its ack;
+// returns REORDER_*, and a packet too far ahead to hold is left
+// unacknowledged so the base station sends it again
+static int uavnode_accept(uavnode               _q,
+                          unsigned int          _id,
+                          unsigned int          _attempt,
+                          const unsigned char * _payload,
+                          unsigned int          _payload_len,
+                          unsigned int          _flags,
+                          framesyncstats_s *    _stats)
+{
+	int stored = reorder_push(_q->rx_buffer, _id, _payload, _payload_len, _flags & FRAMEHEADER_FLAG_AGGREGATED);
+	if (stored == REORDER_TOO_FAR)
+		return stored;
+
+	// a duplicate means our ack was lost, so ack it again
+	uavnode_respond(_q, _q->acks_to_send, _id);
+	evlog_write(_q->event_log, EVLOG_RX, _q->props.session, _id, _attempt, _stats->evm, _stats->rssi);
+	__atomic_add_fetch(&_q->num_valid_packets_received, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&_q->num_valid_bytes_received, _payload_len, __ATOMIC_RELAXED);
+	if (stored == REORDER_DUPLICATE)
+	{
+		__atomic_add_fetch(&_q->num_duplicates_received, 1, __ATOMIC_RELAXED);
+		return stored;
+	}
+	__atomic_add_fetch(&_q->num_unique_bytes_received, _payload_len, __ATOMIC_RELAXED);
+	if (_flags & FRAMEHEADER_FLAG_AGGREGATED)
+	{
+		// split the frame back into the messages packed into it
+		unsigned int offset = 0;
+		const unsigned char * msg;
+		unsigned int msg_len;
+		while (aggregator_next(_payload, _payload_len, &offset, &msg, &msg_len))
+			__atomic_add_fetch(&_q->num_messages_received, 1, __ATOMIC_RELAXED);
+	}
+	return stored;
+}
+
+// accept the _num packets the erasure decoder just rebuilt; they are
+// logged as attempt 0
+static void uavnode_accept_rebuilt(uavnode            _q,
+                                   unsigned int       _num,
+                                   unsigned int       _flags,
+                                   framesyncstats_s * _stats)
+{
+	unsigned int i;
+	unsigned int id;
+	const unsigned char * payload;
+	unsigned int payload_len;
+	for (i=0; i<_num; i++)
+	{
+		erasure_decoder_get(_q->repair_code, i, &id, &payload, &payload_len);
+		if (uavnode_accept(_q, id, 0, payload, payload_len, _flags, _stats) == REORDER_STORED)
+		{
+			__atomic_add_fetch(&_q->num_erasure_recovered, 1, __ATOMIC_RELAXED);
+			if(_q->props.verbose)printf("rx packet id: %6u REBUILT\n", id);
+		}
+	}
+}
+
+// callback function
+int uavnode_callback(unsigned char *  _header,
+		int              _header_valid,
+		unsigned char *  _payload,
+		unsigned int     _payload_len,
+		int              _payload_valid,
+		framesyncstats_s _stats,
+		void *           _userdata)
+{
+	uavnode q = (uavnode) _userdata;
+	frameheader_s h;
+	if (_header_valid)
+		frameheader_decode(&h, _header);
+
+	// frames for other uavs sharing the channel, and acks from other
+	// uavs, are not ours to answer
+	if (_header_valid && (h.session != q->props.session ||
+	                      (h.type != FRAMEHEADER_TYPE_DATA && h.type != FRAMEHEADER_TYPE_REPAIR)))
+		return 0;
+
+	if (_header_valid) 
+	{
+		unsigned int packet_id = h.seq;
+		unsigned int attempt_num = h.info;
+		__atomic_store(&q->evm, &_stats.evm, __ATOMIC_RELAXED);
+		__atomic_store(&q->rssi, &_stats.rssi, __ATOMIC_RELAXED);
+		histogram_add(&q->evm_histogram, _stats.evm);
+		histogram_add(&q->rssi_histogram, _stats.rssi);
+		//simulate missing 10% of packets entirely to trigger timeouts on tx side
+		bool missed = 0; //rand() % 10 == 3 ? true : false;
+		if(missed)
+			std::cout << "missed packet " << packet_id << std::endl;
+		else
+		{
+			timer_tic(q->packet_arrival_timer);
+			if(!q->first_packet_arrived)
+			{
+				timer_tic(q->rx_timer);
+				q->first_packet_arrived = true;
+			}
+			else
+			{
+				float elapsed = timer_toc(q->rx_timer);
+				__atomic_store(&q->total_elapsed_time, &elapsed, __ATOMIC_RELAXED);
+			}
+
+			__atomic_add_fetch(&q->num_valid_headers_received, 1, __ATOMIC_RELAXED);
+			if (h.type == FRAMEHEADER_TYPE_REPAIR)
+			{
+				// rebuild whatever of its block went missing
+				if (q->repair_code != NULL && _payload_valid)
+					uavnode_accept_rebuilt(q, erasure_decoder_add_repair(q->repair_code, packet_id, h.info, _payload, _payload_len), h.flags, &_stats);
+				__atomic_add_fetch(&q->num_frames_detected, 1, __ATOMIC_RELAXED);
+				return 0;
+			}
+
+			//simulate 10% bad payloads to make sure we send some nacks
+			bool still_valid = 1;//rand() % 10 != 3 ? true : false;
+			bool recovered = false;
+			if (q->harq_buffers != NULL)
+			{
+				if (_payload_valid && still_valid)
+				{
+					harq_clear(q->harq_buffers, packet_id);
+				}
+				else
+				{
+					// combine with earlier failed copies of this packet
+					unsigned char * payload = harq_combine(q->harq_buffers, packet_id, &_stats, _payload_len);
+					if (payload != NULL)
+					{
+						_payload = payload;
+						recovered = true;
+						__atomic_add_fetch(&q->num_harq_recovered, 1, __ATOMIC_RELAXED);
+					}
+				}
+			}
+			if ((_payload_valid && still_valid) || recovered)
+			{
+				int stored = uavnode_accept(q, packet_id, attempt_num, _payload, _payload_len, h.flags, &_stats);
+				if (stored != REORDER_TOO_FAR)
+				{
+					if(q->props.verbose)printf("rx packet id: %6u, attempt: %u%s\n", packet_id, attempt_num,
+							stored == REORDER_DUPLICATE ? " DUPLICATE" : recovered ? " VALID (combined)" : " VALID");
+				}
+				else
+				{
+					if(q->props.verbose)printf("rx packet id: %6u BEYOND REORDER WINDOW\n", packet_id);
+				}
+				// it may complete a block the repair frames could not yet
+				if (q->repair_code != NULL)
+					uavnode_accept_rebuilt(q, erasure_decoder_add_data(q->repair_code, packet_id, _payload, _payload_len), h.flags, &_stats);
+			}
+			else if (q->repair_code != NULL)
+			{
+				// the block's repair frames are on their way: rebuild
+				// the packet from them rather than asking for it, and
+				// fall back on the retransmission timeout
+				if(q->props.verbose)printf("rx packet id: %6u PAYLOAD INVALID, waiting for repair\n", packet_id);
+			}
+			else
+			{
+				if(q->props.verbose)printf("rx packet id: %6u", packet_id);
+				uavnode_respond(q, q->nacks_to_send, packet_id);
+				if(q->props.verbose)printf(" PAYLOAD INVALID\n");
+			}
+		}
+	} 
+	else 
+	{
+		if(q->props.verbose)printf("HEADER INVALID\n");
+	}
+	// update global counters
+	__atomic_add_fetch(&q->num_frames_detected, 1, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+// pass in-order data to the configured sink, giving up on it after the
+// first failure
+static int uavnode_sink(const struct iovec * _iov, int _iovcnt, void * _userdata)
+{
+	uavnode q = (uavnode) _userdata;
+	if(q->sink_failed)
+		return 0;
+	if(!q->sink(_iov, _iovcnt, q->sink_userdata))
+	{
+		fprintf(stderr,"warning: uavnode, could not write received data, discarding the rest\n");
+		q->sink_failed = true;
+		return 0;
+	}
+	return 1;
+}
+
+// answer received frames until the link goes quiet or we are stopped
+void uavnode_run(uavnode _q, transceiver * _txcvr)
+{
+	// block ack the queued responses are coalesced into
+	unsigned int id;
+	blockack_s ba;
+	blockack_init(&ba, 0);
+
+	// run conditions
+	float timeout;
+	__atomic_store_n(&_q->running, 1, __ATOMIC_RELEASE);
+
+	while (__atomic_load_n(&_q->running, __ATOMIC_ACQUIRE)) {
+		// answer for everything queued so far with as few block acks
+		// as possible
+		while(spscq_pop(_q->acks_to_send, &id))
+			queue_block_ack(_q, _txcvr, &ba, id, 1);
+		while(spscq_pop(_q->nacks_to_send, &id))
+			queue_block_ack(_q, _txcvr, &ba, id, 0);
+		if(!blockack_empty(&ba))
+		{
+			transmit_block_ack(_q, _txcvr, &ba);
+			blockack_init(&ba, 0);
+		}
+
+		// write out whatever is now in order, after the acks are away
+		reorder_deliver(_q->rx_buffer, _q->sink != NULL ? uavnode_sink : NULL, (void*)_q);
+
+		// sleep until the callback queues another response, waking up
+		// in time to notice the link has gone quiet
+		timeout = _q->first_packet_arrived ? _q->props.rx_timeout - timer_toc(_q->packet_arrival_timer) : _q->props.rx_timeout;
+		if(timeout > 0)
+			event_wait(_q->ack_event, timeout);
+		if(_q->first_packet_arrived && timer_toc(_q->packet_arrival_timer) > _q->props.rx_timeout)
+		{
+			std::cout << "no packets received for " << _q->props.rx_timeout << " seconds, quitting." << std::endl;
+			__atomic_store_n(&_q->running, 0, __ATOMIC_RELEASE);
+		}
+	}
+	reorder_deliver(_q->rx_buffer, _q->sink != NULL ? uavnode_sink : NULL, (void*)_q);
+}
+
+// make uavnode_run() return
+void uavnode_stop(uavnode _q)
+{
+	__atomic_store_n(&_q->running, 0, __ATOMIC_RELEASE);
+	event_signal(_q->ack_event);
+}
+
+// get link counters
+void uavnode_get_stats(uavnode _q, uavnode_stats_s * _stats)
+{
+	_stats->num_frames_detected = __atomic_load_n(&_q->num_frames_detected, __ATOMIC_RELAXED);
+	_stats->num_valid_headers_received = __atomic_load_n(&_q->num_valid_headers_received, __ATOMIC_RELAXED);
+	_stats->num_valid_packets_received = __atomic_load_n(&_q->num_valid_packets_received, __ATOMIC_RELAXED);
+	_stats->num_valid_bytes_received = __atomic_load_n(&_q->num_valid_bytes_received, __ATOMIC_RELAXED);
+	_stats->num_duplicates_received = __atomic_load_n(&_q->num_duplicates_received, __ATOMIC_RELAXED);
+	_stats->num_unique_bytes_received = __atomic_load_n(&_q->num_unique_bytes_received, __ATOMIC_RELAXED);
+	_stats->num_harq_recovered = __atomic_load_n(&_q->num_harq_recovered, __ATOMIC_RELAXED);
+	_stats->num_erasure_recovered = __atomic_load_n(&_q->num_erasure_recovered, __ATOMIC_RELAXED);
+	_stats->num_messages_received = __atomic_load_n(&_q->num_messages_received, __ATOMIC_RELAXED);
+	_stats->num_acks_sent = __atomic_load_n(&_q->num_acks_sent, __ATOMIC_RELAXED);
+	_stats->num_responses_dropped = __atomic_load_n(&_q->num_responses_dropped, __ATOMIC_RELAXED);
+	//compute runtime = time of last packet arrival - time of first packet arrival
+	__atomic_load(&_q->total_elapsed_time, &_stats->runtime, __ATOMIC_RELAXED);
+}
+
+// get quality of the frames addressed to us
+void uavnode_get_link_quality(uavnode _q, histogram_s * _evm, histogram_s * _rssi)
+{
+	histogram_copy(_evm, &_q->evm_histogram);
+	histogram_copy(_rssi, &_q->rssi_histogram);
+}
+
+// print link counters and data rate
+void uavnode_print_stats(uavnode _q)
+{
+	uavnode_stats_s s;
+	uavnode_get_stats(_q, &s);
+
+	// print results
+	// goodput: each packet's payload counted once
+	float data_rate = s.num_unique_bytes_received * 8.0f / s.runtime;
+	float percent_headers_valid = (s.num_frames_detected == 0) ?
+		0.0f :
+		100.0f * (float)s.num_valid_headers_received / (float)s.num_frames_detected;
+	float percent_packets_valid = (s.num_frames_detected == 0) ?
+		0.0f :
+		100.0f * (float)s.num_valid_packets_received / (float)s.num_frames_detected;
+	printf("    frames detected     : %6u\n", s.num_frames_detected);
+	printf("    valid headers       : %6u (%6.2f%%)\n", s.num_valid_headers_received,percent_headers_valid);
+	printf("    valid packets       : %6u (%6.2f%%)\n", s.num_valid_packets_received,percent_packets_valid);
+	printf("    bytes received      : %6u\n", s.num_valid_bytes_received);
+	printf("    duplicates          : %6u\n", s.num_duplicates_received);
+	printf("    unique bytes        : %6u\n", s.num_unique_bytes_received);
+	if(reorder_size(_q->rx_buffer) > 0)
+		printf("    held for a gap      : %6u packets, from id %u\n", reorder_size(_q->rx_buffer), reorder_next(_q->rx_buffer));
+	if(_q->harq_buffers != NULL)
+		printf("    harq recovered      : %6u\n", s.num_harq_recovered);
+	if(_q->repair_code != NULL)
+		printf("    erasure recovered   : %6u\n", s.num_erasure_recovered);
+	if(s.num_responses_dropped > 0)
+		printf("    responses dropped   : %6u\n", s.num_responses_dropped);
+	if(s.num_messages_received > 0)
+	{
+		printf("    messages received   : %6u\n", s.num_messages_received);
+		printf("    message rate        : %8.1f msg/s\n", s.num_messages_received / s.runtime);
+	}
+	if(histogram_count(&_q->evm_histogram) > 0)
+		printf("    mean EVM / RSSI     : %6.1f dB / %6.1f dB\n", histogram_mean(&_q->evm_histogram), histogram_mean(&_q->rssi_histogram));
+	printf("    run time            : %f s\n", s.runtime);
+	printf("    data rate           : %8.4f kbps\n", data_rate*1e-3f);
+}
@@ -0,0 +1,89 @@
+//
+// uavnode
+//
+// UAV side of the ARQ link: receives data frames from the base station
+// over any transceiver and answers them with block acks. Packets lost
+// from a block can be rebuilt from the block's repair frames.
+//
+
+#ifndef __UAVNODE_H__
+#define __UAVNODE_H__
+
+#include "transceiver.h"
+#include "evlog.h"
+#include "session.h"
+#include "histogram.h"
+#include "reorder.h"
+
+struct uavnode_props_s {
+    unsigned int session;           // session id given by the base station
+    float rx_timeout;               // quit after this long without frames [s]
+    unsigned int harq_buffers;      // failed packets kept for soft
+                                    // combining, 0 disables harq
+    unsigned int reorder_window;    // packets held waiting for an earlier
+                                    // one; later ones go unacknowledged
+    unsigned int erasure_window;    // recent payloads kept to rebuild lost
+                                    // ones from repair frames instead of
+                                    // nacking them (see erasure.h), 0
+                                    // disables
+    const char * output;            // write the received data in order to
+                                    // this file or pipe, NULL for none
+    reorder_sink sink;              // or hand it to this callback, NULL
+    void * sink_userdata;           // for none
+    bool verbose;
+};
+
+// uav defaults
+void uavnode_props_init_default(uavnode_props_s * _props);
+
+struct uavnode_stats_s {
+    unsigned int num_frames_detected;
+    unsigned int num_valid_headers_received;
+    unsigned int num_valid_packets_received;
+    unsigned int num_valid_bytes_received;  // including duplicates
+    unsigned int num_duplicates_received;   // valid payloads received before
+    unsigned int num_unique_bytes_received; // payload bytes, each packet once
+    unsigned int num_harq_recovered;    // payloads decoded only by combining
+    unsigned int num_erasure_recovered; // payloads rebuilt from repair frames
+    unsigned int num_messages_received; // messages split out of aggregated
+                                        // frames
+    unsigned int num_acks_sent;     // block-ack frames sent
+    unsigned int num_responses_dropped; // acks/nacks lost to a full queue
+    float runtime;                  // first to last frame arrival [s]
+};
+
+typedef struct uavnode_s * uavnode;
+
+// create uav; events are recorded to _log unless it is NULL
+uavnode uavnode_create(uavnode_props_s * _props, evlog _log);
+
+// destroy uav
+void uavnode_destroy(uavnode _q);
+
+// framesync callback for the uav's transceiver; _userdata must be the
+// uavnode
+int uavnode_callback(unsigned char *  _header,
+                     int              _header_valid,
+                     unsigned char *  _payload,
+                     unsigned int     _payload_len,
+                     int              _payload_valid,
+                     framesyncstats_s _stats,
+                     void *           _userdata);
+
+// answer received frames over _txcvr until no frame has arrived for
+// rx_timeout seconds or uavnode_stop() is called
+void uavnode_run(uavnode _q, transceiver * _txcvr);
+
+// make uavnode_run() return (from any thread)
+void uavnode_stop(uavnode _q);
+
+// get link counters (from any thread, while uavnode_run() is going)
+void uavnode_get_stats(uavnode _q, uavnode_stats_s * _stats);
+
+// get EVM and RSSI [dB] of the frames addressed to this uav
+void uavnode_get_link_quality(uavnode _q, histogram_s * _evm, histogram_s * _rssi);
+
+// print link counters and data rate
+void uavnode_print_stats(uavnode _q);
+
+#endif // __UAVNODE_H__
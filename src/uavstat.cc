@@ -0,0 +1,160 @@
+//
+// uavstat
+//
+// Watch the live link statistics BaseStation or UAV publishes in shared
+// memory. Prints one line per interval with the goodput, frame rate and
+// link quality over that interval, until the publisher exits.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "linkstats.h"
+
+void usage() {
+	printf("Usage: uavstat [options] [segment]\n");
+	printf("  Reads %s, or %s if that does not exist, unless a segment is given.\n",
+			LINKSTATS_NAME_BASESTATION, LINKSTATS_NAME_UAV);
+	printf("  --interval			Set the time between lines\n");
+	printf("								[Default: 1 second]\n");
+	printf("  --once				Print the totals so far once and exit\n");
+	printf("  --help				Display this help message\n");
+	exit(0);
+}
+
+// samples added to _cur since _prev was taken
+void histogram_delta(histogram_s * _d, const histogram_s * _cur, const histogram_s * _prev)
+{
+	*_d = *_cur;
+	unsigned int i;
+	for(i=0; i<HISTOGRAM_NUM_BINS; i++)
+		_d->bins[i] -= _prev->bins[i];
+	_d->count -= _prev->count;
+	_d->sum -= _prev->sum;
+}
+
+void print_header(const linkstats_page_s * _s)
+{
+	if(_s->source == LINKSTATS_SOURCE_BASESTATION)
+		printf("%9s %10s %8s %8s %6s %6s %6s %8s %8s %7s %7s\n", "time[s]", "goodput", "frames/s",
+				"acked", "acks", "nacks", "tmouts", "rtt50", "rtt99", "evm", "rssi");
+	else
+		printf("%9s %10s %8s %8s %6s %6s %6s %7s %7s\n", "time[s]", "goodput", "frames/s",
+				"valid", "acks", "harq", "msgs", "evm", "rssi");
+}
+
+// one line of rates over [_prev, _cur] and counts since the start
+void print_line(const linkstats_page_s * _cur, const linkstats_page_s * _prev)
+{
+	double t = (_cur->update_clock - _cur->start_clock) * 1e-9;
+	double dt = (_cur->update_clock - _prev->update_clock) * 1e-9;
+	if(dt <= 0)
+		dt = t > 0 ? t : 1;
+	// counters wrap at 32 bits; differences survive that
+	unsigned int bytes = _cur->bytes_delivered - _prev->bytes_delivered;
+	unsigned int frames = _cur->frames_detected - _prev->frames_detected;
+	if(_cur->source == LINKSTATS_SOURCE_BASESTATION)
+		frames = _cur->frames_sent - _prev->frames_sent;
+	char goodput[32];
+	snprintf(goodput, sizeof(goodput), "%.1fk", bytes * 8e-3 / dt);
+
+	histogram_s rtt, evm, rssi;
+	histogram_delta(&rtt, &_cur->rtt, &_prev->rtt);
+	histogram_delta(&evm, &_cur->evm, &_prev->evm);
+	histogram_delta(&rssi, &_cur->rssi, &_prev->rssi);
+
+	if(_cur->source == LINKSTATS_SOURCE_BASESTATION)
+		printf("%9.1f %10s %8.1f %8u %6u %6u %6u %8.2f %8.2f %7.1f %7.1f\n", t, goodput, frames / dt,
+				_cur->packets_delivered, _cur->acks, _cur->nacks, _cur->timeouts,
+				histogram_percentile(&rtt, 0.5f)*1e3f, histogram_percentile(&rtt, 0.99f)*1e3f,
+				histogram_mean(&evm), histogram_mean(&rssi));
+	else
+		printf("%9.1f %10s %8.1f %8u %6u %6u %6u %7.1f %7.1f\n", t, goodput, frames / dt,
+				_cur->packets_delivered, _cur->frames_sent, _cur->harq_recovered, _cur->messages,
+				histogram_mean(&evm), histogram_mean(&rssi));
+	fflush(stdout);
+}
+
+int main (int argc, char **argv)
+{
+	float interval = 1.0f;
+	bool once = false;
+
+	int c;
+	static struct option long_options[] = {
+		{"interval",	required_argument, 0, 'a'},
+		{"once",		no_argument,       0, 'b'},
+		{"help",		no_argument,       0, 'c'},
+		{0, 0, 0, 0},
+	};
+	int option_index = 0;
+	while (1)
+	{
+		c = getopt_long(argc, argv, "", long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c)
+		{
+			case 'a' :
+				interval = atof(optarg);
+				break;
+			case 'b' :
+				once = true;
+				break;
+			case 'c' :
+			default :
+				usage();
+		}
+	}
+	if(interval <= 0)
+	{
+		fprintf(stderr,"error: %s, interval must be positive\n", argv[0]);
+		exit(1);
+	}
+
+	const char * name = optind < argc ? argv[optind] : NULL;
+	const linkstats_page_s * page = NULL;
+	if(name != NULL)
+		page = linkstats_map(name);
+	else if((page = linkstats_map(name = LINKSTATS_NAME_BASESTATION)) == NULL)
+		page = linkstats_map(name = LINKSTATS_NAME_UAV);
+	if(page == NULL)
+	{
+		fprintf(stderr,"error: %s, no link stats published at '%s'\n", argv[0], name);
+		exit(1);
+	}
+
+	linkstats_page_s prev;
+	linkstats_page_s cur;
+	if(!linkstats_read(page, &cur))
+	{
+		fprintf(stderr,"error: %s, '%s' does not hold link stats of this version\n", argv[0], name);
+		exit(1);
+	}
+	printf("%s: %s, pid %d\n", name,
+			cur.source == LINKSTATS_SOURCE_BASESTATION ? "base station" : "uav", cur.pid);
+	print_header(&cur);
+
+	// rates of the first line cover everything since the start
+	memset(&prev, 0x00, sizeof(prev));
+	prev.update_clock = cur.start_clock;
+	histogram_init(&prev.rtt, cur.rtt.min, cur.rtt.max, cur.rtt.log_scale);
+	histogram_init(&prev.evm, cur.evm.min, cur.evm.max, cur.evm.log_scale);
+	histogram_init(&prev.rssi, cur.rssi.min, cur.rssi.max, cur.rssi.log_scale);
+	while(1)
+	{
+		print_line(&cur, &prev);
+		if(once || !cur.running)
+			break;
+		usleep((useconds_t)(interval*1e6f));
+		prev = cur;
+		linkstats_read(page, &cur);
+	}
+	if(!cur.running)
+		printf("publisher exited.\n");
+
+	linkstats_unmap(page);
+	return 0;
+}
@@ -0,0 +1,38 @@
+//
+// usrp_transceiver
+//
+
+#include "usrp_transceiver.h"
+
+usrp_transceiver::usrp_transceiver(unsigned int       _M,
+                                   unsigned int       _cp_len,
+                                   unsigned int       _taper_len,
+                                   unsigned char *    _p,
+                                   framesync_callback _callback,
+                                   void *             _userdata) :
+    txcvr(_M, _cp_len, _taper_len, _p, _callback, _userdata)
+{
+}
+
+void usrp_transceiver::set_tx_freq(float _tx_freq)           { txcvr.set_tx_freq(_tx_freq); }
+void usrp_transceiver::set_tx_rate(float _tx_rate)           { txcvr.set_tx_rate(_tx_rate); }
+void usrp_transceiver::set_tx_gain_soft(float _tx_gain_soft) { txcvr.set_tx_gain_soft(_tx_gain_soft); }
+void usrp_transceiver::set_tx_gain_uhd(float _tx_gain_uhd)   { txcvr.set_tx_gain_uhd(_tx_gain_uhd); }
+
+void usrp_transceiver::transmit_packet(unsigned char *   _header,
+                                       unsigned char *   _payload,
+                                       unsigned int      _payload_len,
+                                       modulation_scheme _mod,
+                                       fec_scheme        _fec0,
+                                       fec_scheme        _fec1)
+{
+    txcvr.transmit_packet(_header, _payload, _payload_len, _mod, _fec0, _fec1);
+}
+
+void usrp_transceiver::set_rx_freq(float _rx_freq)           { txcvr.set_rx_freq(_rx_freq); }
+void usrp_transceiver::set_rx_rate(float _rx_rate)           { txcvr.set_rx_rate(_rx_rate); }
+void usrp_transceiver::set_rx_gain_uhd(float _rx_gain_uhd)   { txcvr.set_rx_gain_uhd(_rx_gain_uhd); }
+
+void usrp_transceiver::start_rx()     { txcvr.start_rx(); }
+void usrp_transceiver::stop_rx()      { txcvr.stop_rx(); }
+void usrp_transceiver::debug_enable() { txcvr.debug_enable(); }
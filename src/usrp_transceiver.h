@@ -0,0 +1,47 @@
+//
+// usrp_transceiver
+//
+// transceiver backed by liquid-usrp's ofdmtxrx and a USRP.
+//
+
+#ifndef __USRP_TRANSCEIVER_H__
+#define __USRP_TRANSCEIVER_H__
+
+#include <liquid/ofdmtxrx.h>
+#include "transceiver.h"
+
+class usrp_transceiver : public transceiver {
+public:
+    usrp_transceiver(unsigned int       _M,
+                     unsigned int       _cp_len,
+                     unsigned int       _taper_len,
+                     unsigned char *    _p,
+                     framesync_callback _callback,
+                     void *             _userdata);
+
+    void set_tx_freq(float _tx_freq);
+    void set_tx_rate(float _tx_rate);
+    void set_tx_gain_soft(float _tx_gain_soft);
+    void set_tx_gain_uhd(float _tx_gain_uhd);
+
+    void transmit_packet(unsigned char *   _header,
+                         unsigned char *   _payload,
+                         unsigned int      _payload_len,
+                         modulation_scheme _mod,
+                         fec_scheme        _fec0,
+                         fec_scheme        _fec1);
+
+    void set_rx_freq(float _rx_freq);
+    void set_rx_rate(float _rx_rate);
+    void set_rx_gain_uhd(float _rx_gain_uhd);
+
+    void start_rx();
+    void stop_rx();
+
+    void debug_enable();
+
+private:
+    ofdmtxrx txcvr;
+};
+
+#endif // __USRP_TRANSCEIVER_H__